@@ -0,0 +1,33 @@
+// sokol for the headless benchmarks: the dummy gfx backend and no sokol_app implementation, so nothing here needs a
+// window or a GPU. the library only asks sokol_app for the screen size, which the benchmarks set themselves.
+
+#define SOKOL_LOG_IMPL
+#define SOKOL_TIME_IMPL
+#define SOKOL_GFX_IMPL
+#define SOKOL_DUMMY_BACKEND
+#define SOKOL_DEBUG
+
+#include "sokol_impl.h"
+
+#define HANDMADE_MATH_IMPLEMENTATION
+#define HANDMADE_MATH_CPP_MODE
+#include "external/HandmadeMath.h"
+
+int bench_screen_width  = 1920;
+int bench_screen_height = 1080;
+
+int sapp_width() {
+    return bench_screen_width;
+}
+
+int sapp_height() {
+    return bench_screen_height;
+}
+
+float sapp_widthf() {
+    return (float)bench_screen_width;
+}
+
+float sapp_heightf() {
+    return (float)bench_screen_height;
+}
@@ -0,0 +1,12 @@
+#!/bin/sh
+# builds the headless benchmarks into build/. no window or GPU needed, so these run on CI boxes too.
+# run from the repo root.
+set -e
+CXX=${CXX:-g++}
+FLAGS="-O2 -g -std=c++14 -DNDEBUG -Isrc"
+mkdir -p build
+$CXX $FLAGS bench/ui_bench.cpp bench/bench_sokol_impl.cpp src/core.cpp src/ui.cpp src/draw.cpp src/profiler.cpp src/stb.cpp -o build/ui_bench -lm -lpthread -ldl
+$CXX $FLAGS bench/vertex_bench.cpp bench/bench_sokol_impl.cpp src/core.cpp src/ui.cpp src/draw.cpp src/profiler.cpp src/stb.cpp -o build/vertex_bench -lm -lpthread -ldl
+$CXX $FLAGS -mavx2 bench/vertex_bench.cpp bench/bench_sokol_impl.cpp src/core.cpp src/ui.cpp src/draw.cpp src/profiler.cpp src/stb.cpp -o build/vertex_bench_avx2 -lm -lpthread -ldl
+$CXX $FLAGS bench/id_hash_bench.cpp src/core.cpp -o build/id_hash_bench -lpthread
+$CXX $FLAGS bench/sort_bench.cpp src/core.cpp -o build/sort_bench -lpthread
@@ -0,0 +1,160 @@
+// microbenchmark for widget id hashing: the old byte-at-a-time FNV against hash_bytes()/hash_combine().
+//
+// built along with the other benchmarks by bench/build.sh and build_bench.bat
+
+#include "core.h"
+
+#define SOKOL_TIME_IMPL
+#include "external/sokol_time.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t fnv8_combine(uint64_t h, const uint8_t *data, int64_t len) {
+    FOR (i, 0, len-1) {
+        h = (h * 0x100000001b3) ^ (uint64_t)data[i];
+    }
+    return h;
+}
+
+// keeps the optimizer from dropping the loops
+static volatile uint64_t sink;
+
+static void report(const char *name, int64_t ops, uint64_t ticks) {
+    double ns = stm_ns(ticks) / (double)ops;
+    printf("  %-34s %7.2f ns/id  %8.1f M ids/s\n", name, ns, 1000.0 / ns);
+}
+
+#define BENCH_ITERATIONS 20
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main() {
+    stm_setup();
+    temp_arena = bootstrap_arena(default_allocator(), 64 * 1024 * 1024);
+
+    const int64_t count = 1 << 16;
+
+    // the shapes of id that show up in practice: short literals, tprint'd names, indices and pointers
+    String literals[] = {"button1", "grid", "example", "scroll view", "center scroll list", "top horizontal scroll"};
+    List<String> printed = make_list<String>(default_allocator(), count);
+    FOR (i, 0, count-1) {
+        printed.add(tprint("inventory slot %lld", (long long)i));
+    }
+    List<void *> pointers = make_list<void *>(default_allocator(), count);
+    FOR (i, 0, count-1) {
+        pointers.add(&printed[i]);
+    }
+
+    struct { const char *name; String *strings; int64_t string_count; } string_sets[] = {
+        {"literals",        literals,     (int64_t)(sizeof(literals) / sizeof(literals[0]))},
+        {"tprint'd names",  printed.data, printed.count},
+    };
+
+    for (auto &set : string_sets) {
+        printf("%s:\n", set.name);
+        uint64_t h = 0;
+        uint64_t start = stm_now();
+        FOR (it, 0, BENCH_ITERATIONS-1) {
+            FOR (i, 0, count-1) {
+                String s = set.strings[i % set.string_count];
+                h = fnv8_combine(h, s.data, s.count);
+            }
+        }
+        report("fnv8_combine", count * BENCH_ITERATIONS, stm_since(start));
+        sink = h;
+
+        start = stm_now();
+        FOR (it, 0, BENCH_ITERATIONS-1) {
+            FOR (i, 0, count-1) {
+                String s = set.strings[i % set.string_count];
+                h = hash_combine(h, hash_bytes(s.data, s.count));
+            }
+        }
+        report("hash_combine(hash_bytes)", count * BENCH_ITERATIONS, stm_since(start));
+        sink = h;
+    }
+
+    // what a literal id costs when its hash is computed at compile time, which HASH_LITERAL() (and so UI_ID())
+    // guarantees even at -O0
+    {
+        const uint64_t literal_hashes[] = {
+            HASH_LITERAL("button1"), HASH_LITERAL("grid"), HASH_LITERAL("example"),
+            HASH_LITERAL("scroll view"), HASH_LITERAL("center scroll list"), HASH_LITERAL("top horizontal scroll"),
+        };
+        printf("literals, hashed at compile time:\n");
+        uint64_t h = 0;
+        uint64_t start = stm_now();
+        FOR (it, 0, BENCH_ITERATIONS-1) {
+            FOR (i, 0, count-1) {
+                h = hash_combine(h, literal_hashes[i % 6]);
+            }
+        }
+        report("hash_combine", count * BENCH_ITERATIONS, stm_since(start));
+        sink = h;
+    }
+
+    printf("int64 indices:\n");
+    {
+        uint64_t h = 0;
+        uint64_t start = stm_now();
+        FOR (it, 0, BENCH_ITERATIONS-1) {
+            FOR (i, 0, count-1) {
+                h = fnv8_combine(h, (uint8_t *)&i, sizeof(i));
+            }
+        }
+        report("fnv8_combine", count * BENCH_ITERATIONS, stm_since(start));
+        sink = h;
+
+        start = stm_now();
+        FOR (it, 0, BENCH_ITERATIONS-1) {
+            FOR (i, 0, count-1) {
+                h = hash_combine(h, (uint64_t)i);
+            }
+        }
+        report("hash_combine", count * BENCH_ITERATIONS, stm_since(start));
+        sink = h;
+    }
+
+    printf("pointers:\n");
+    {
+        uint64_t h = 0;
+        uint64_t start = stm_now();
+        FOR (it, 0, BENCH_ITERATIONS-1) {
+            FOR (i, 0, count-1) {
+                void *ptr = pointers[i];
+                h = fnv8_combine(h, (uint8_t *)&ptr, sizeof(ptr));
+            }
+        }
+        report("fnv8_combine", count * BENCH_ITERATIONS, stm_since(start));
+        sink = h;
+
+        start = stm_now();
+        FOR (it, 0, BENCH_ITERATIONS-1) {
+            FOR (i, 0, count-1) {
+                h = hash_combine(h, (uint64_t)(uintptr_t)pointers[i]);
+            }
+        }
+        report("hash_combine", count * BENCH_ITERATIONS, stm_since(start));
+        sink = h;
+    }
+
+    // sanity check on distribution: ids for every (parent, index) pair of a big table should all differ
+    {
+        const int64_t parents = 256;
+        List<uint64_t> ids = make_list<uint64_t>(default_allocator(), parents * count);
+        FOR (p, 0, parents-1) {
+            uint64_t parent = hash_combine(HASH_SECRET_1, hash_bytes(printed[p].data, printed[p].count));
+            FOR (i, 0, count-1) {
+                ids.add(hash_combine(parent, (uint64_t)i));
+            }
+        }
+        radix_sort(ids.data, ids.count, 0, 64, default_allocator());
+        int64_t duplicates = 0;
+        FOR (i, 1, ids.count-1) {
+            if (ids[i] == ids[i-1]) {
+                duplicates += 1;
+            }
+        }
+        printf("%lld ids, %lld duplicates\n", (long long)ids.count, (long long)duplicates);
+    }
+}
@@ -0,0 +1,174 @@
+// microbenchmark for sort_by_layer_and_serial() on 100k commands, against the qsort() of whole 144 byte commands that
+// draw_flush() used to do. covers commands in order, the usual nearly-ordered frame, and inputs with shuffled layers
+// and serials where nothing is in order.
+//
+// built along with the other benchmarks by bench/build.sh and build_bench.bat
+
+#include "core.h"
+
+#define SOKOL_TIME_IMPL
+#include "external/sokol_time.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+// the size and sort fields of Draw_Command before it was split into a header and a payload
+struct Old_Draw_Command {
+    int64_t layer;
+    int64_t serial;
+    uint8_t rest[128];
+};
+
+static_assert(sizeof(Old_Draw_Command) == 144, "Old_Draw_Command should match the old Draw_Command");
+
+// and the header draw_flush() gathers the keys out of now
+struct Draw_Command_Header {
+    int64_t layer;
+    int64_t serial;
+    uint64_t rest;
+};
+
+static_assert(sizeof(Draw_Command_Header) == 24, "Draw_Command_Header should match Draw_Command");
+
+static int compare_old_draw_commands(const void *_a, const void *_b) {
+    const Old_Draw_Command *a = (const Old_Draw_Command *)_a;
+    const Old_Draw_Command *b = (const Old_Draw_Command *)_b;
+    if (a->layer == b->layer) {
+        return (int)(a->serial - b->serial);
+    }
+    return (int)(a->layer - b->layer);
+}
+
+#define SORT_COMMANDS    100000
+#define BENCH_ITERATIONS 10
+
+enum Sort_Input {
+    SORT_INPUT_IN_ORDER,
+    SORT_INPUT_NEARLY_IN_ORDER,
+    SORT_INPUT_SHUFFLED_LAYERS,
+    SORT_INPUT_SHUFFLED_LAYERS_AND_SERIALS,
+    SORT_INPUT_SCATTERED_LAYERS,
+    SORT_INPUT_COUNT,
+};
+
+static const char *sort_input_names[SORT_INPUT_COUNT] = {
+    "in order",
+    "nearly in order",
+    "shuffled layers",
+    "shuffled layers and serials",
+    "scattered layers",
+};
+
+static void make_input(Sort_Input input, int64_t *layers, int64_t *serials, int64_t count) {
+    uint64_t rng = make_random(1234);
+    FOR (i, 0, count-1) {
+        layers[i] = 0;
+        serials[i] = i + 1;
+    }
+    switch (input) {
+        case SORT_INPUT_IN_ORDER: {
+            break;
+        }
+        case SORT_INPUT_NEARLY_IN_ORDER: {
+            // a drag-drop layer over the base one, and the odd serial moved by draw_set_next_serial()
+            FOR (i, 0, count-1) {
+                layers[i] = random_range_int(&rng, 0, 4) == 0 ? 10000 : 0;
+            }
+            for (int64_t i = 0; i + 7 < count; i += 50) {
+                int64_t swap = serials[i];
+                serials[i] = serials[i+7];
+                serials[i+7] = swap;
+            }
+            break;
+        }
+        case SORT_INPUT_SHUFFLED_LAYERS:
+        case SORT_INPUT_SHUFFLED_LAYERS_AND_SERIALS: {
+            FOR (i, 0, count-1) {
+                layers[i] = random_range_int(&rng, 0, 7) * 100 - 300;
+            }
+            if (input == SORT_INPUT_SHUFFLED_LAYERS_AND_SERIALS) {
+                FORR (i, 1, count-1) {
+                    int64_t j = random_range_int(&rng, 0, i);
+                    int64_t swap = serials[i];
+                    serials[i] = serials[j];
+                    serials[j] = swap;
+                }
+            }
+            break;
+        }
+        case SORT_INPUT_SCATTERED_LAYERS: {
+            // too many distinct layers to rank, so they're keyed by their offset from the smallest
+            FOR (i, 0, count-1) {
+                layers[i] = random_range_int(&rng, -100000, 100000);
+                serials[i] = random_range_int(&rng, 0, count * 4);
+            }
+            break;
+        }
+        default: {
+            assert(false);
+        }
+    }
+}
+
+static double best_ms(List<double> samples) {
+    double best = samples[0];
+    FOR (i, 1, samples.count-1) {
+        best = samples[i] < best ? samples[i] : best;
+    }
+    return best;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main() {
+    stm_setup();
+    temp_arena = bootstrap_arena(default_allocator(), 64 * 1024 * 1024);
+
+    const int64_t count = SORT_COMMANDS;
+    int64_t *layers  = (int64_t *)alloc(default_allocator(), sizeof(int64_t) * count, alignof(int64_t), false);
+    int64_t *serials = (int64_t *)alloc(default_allocator(), sizeof(int64_t) * count, alignof(int64_t), false);
+    Old_Draw_Command *old_commands = (Old_Draw_Command *)alloc(default_allocator(), sizeof(Old_Draw_Command) * count, alignof(Old_Draw_Command), true);
+    Draw_Command_Header *commands = (Draw_Command_Header *)alloc(default_allocator(), sizeof(Draw_Command_Header) * count, alignof(Draw_Command_Header), true);
+    List<double> qsort_samples = make_list<double>(default_allocator(), BENCH_ITERATIONS);
+    List<double> radix_samples = make_list<double>(default_allocator(), BENCH_ITERATIONS);
+
+    printf("%d commands, best of %d:\n", SORT_COMMANDS, BENCH_ITERATIONS);
+    FOR (input, 0, SORT_INPUT_COUNT-1) {
+        make_input((Sort_Input)input, layers, serials, count);
+        qsort_samples.reset();
+        radix_samples.reset();
+        FOR (it, 0, BENCH_ITERATIONS-1) {
+            FOR (i, 0, count-1) {
+                old_commands[i].layer = layers[i];
+                old_commands[i].serial = serials[i];
+                commands[i].layer = layers[i];
+                commands[i].serial = serials[i];
+            }
+            uint64_t start = stm_now();
+            qsort(old_commands, count, sizeof(Old_Draw_Command), compare_old_draw_commands);
+            qsort_samples.add(stm_ms(stm_since(start)));
+
+            // draw_flush() gathers the keys out of the commands first, so that's timed too
+            temp_arena->reset();
+            start = stm_now();
+            List<int64_t> gathered_layers  = make_list<int64_t>(temp(), count);
+            List<int64_t> gathered_serials = make_list<int64_t>(temp(), count);
+            FOR (i, 0, count-1) {
+                gathered_layers.add(commands[i].layer);
+                gathered_serials.add(commands[i].serial);
+            }
+            List<int64_t> order = sort_by_layer_and_serial(gathered_layers.data, gathered_serials.data, count, temp());
+            radix_samples.add(stm_ms(stm_since(start)));
+
+            FOR (i, 1, count-1) {
+                int64_t a = order[i-1];
+                int64_t b = order[i];
+                assert(layers[a] < layers[b] || (layers[a] == layers[b] && serials[a] <= serials[b]));
+                UNUSED(a);
+                UNUSED(b);
+            }
+        }
+        double qsort_ms = best_ms(qsort_samples);
+        double radix_ms = best_ms(radix_samples);
+        printf("  %-30s qsort %8.3f ms   sort_by_layer_and_serial %8.3f ms   %5.1fx\n", sort_input_names[input], qsort_ms, radix_ms, qsort_ms / radix_ms);
+    }
+}
@@ -0,0 +1,385 @@
+// headless benchmarks for ui + draw. drives ui_new_frame -> scene -> ui_end_frame -> draw_flush against the sokol
+// dummy backend and reports per-phase frame time percentiles, allocations and vertex counts for each scene.
+//
+// build and run from the repo root, the text scenes load resources/fonts/roboto.ttf:
+//     bench/build.sh && build/ui_bench [frames] [scene name filter]
+//     build_bench.bat && ui_bench.exe [frames] [scene name filter]
+
+#include "core.h"
+#include "draw.h"
+#include "ui.h"
+
+extern int bench_screen_width;
+extern int bench_screen_height;
+
+static Font *bench_font;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Scenes. each one builds a frame's worth of ui and returns how many widgets it updated.
+//
+
+static int64_t scene_buttons(int64_t n) {
+    int64_t columns = 100;
+    float w = sapp_widthf() / columns;
+    float h = sapp_heightf() / (float)(n / columns + 1);
+    FOR (i, 0, n-1) {
+        UI_PUSH_ID(i);
+        float x = (i % columns) * w;
+        float y = (i / columns) * h;
+        ui_button({{x, y}, {x + w, y + h}}, "", {});
+    }
+    return n;
+}
+
+// a background quad and a label per button, alternating between the two
+static int64_t scene_labeled_buttons(int64_t n) {
+    Text_Settings settings = {};
+    settings.font   = bench_font;
+    settings.valign = Text_VAlign::CENTER;
+    settings.halign = Text_HAlign::CENTER;
+    settings.color  = v4(1, 1, 1, 1);
+    int64_t columns = 20;
+    float w = sapp_widthf() / columns;
+    float h = sapp_heightf() / (float)(n / columns + 1);
+    FOR (i, 0, n-1) {
+        UI_PUSH_ID(i);
+        float x = (i % columns) * w;
+        float y = (i / columns) * h;
+        ui_button({{x, y}, {x + w, y + h}}, "", {}, tprint("button %lld", (long long)i), settings);
+    }
+    return n;
+}
+
+// plain draw_quad()s with no widgets behind them, for measuring draw_flush on its own
+static int64_t scene_quads(int64_t n) {
+    int64_t columns = 400;
+    float w = sapp_widthf() / columns;
+    float h = sapp_heightf() / (float)(n / columns + 1);
+    FOR (i, 0, n-1) {
+        float x = (i % columns) * w;
+        float y = (i / columns) * h;
+        draw_quad(v2(x, y), v2(x + w * 0.9f, y + h * 0.9f), v4(1, (float)(i & 255) / 255.0f, 0.5f, 1));
+    }
+    return 0;
+}
+
+static int64_t scene_text_labels(int64_t n) {
+    Text_Settings settings = {};
+    settings.font   = bench_font;
+    settings.valign = Text_VAlign::CENTER;
+    settings.halign = Text_HAlign::LEFT;
+    settings.color  = v4(1, 1, 1, 1);
+    int64_t columns = 20;
+    float w = sapp_widthf() / columns;
+    float h = sapp_heightf() / (float)(n / columns + 1);
+    FOR (i, 0, n-1) {
+        float x = (i % columns) * w;
+        float y = (i / columns) * h;
+        ui_text({{x, y}, {x + w, y + h}}, tprint("label %lld", (long long)i), settings);
+    }
+    return 0;
+}
+
+static int64_t nested_scroll_views(Rect rect, int64_t depth) {
+    Rect content_rect = {};
+    push_scroll_view(rect, "scroll view", SCROLL_VIEW_VERTICAL, &content_rect);
+    defer (pop_scroll_view());
+    int64_t widgets = 1;
+
+    Rect cursor = content_rect;
+    if (depth > 0) {
+        FOR (child, 0, 1) {
+            UI_PUSH_ID(child);
+            Rect child_rect = cursor.cut_top(rect.height() * 0.3f / ui_scale_factor);
+            expand_current_scroll_view(child_rect);
+            widgets += nested_scroll_views(child_rect.inset(4), depth-1);
+        }
+    }
+    FOR (i, 0, 19) {
+        UI_PUSH_ID(i);
+        Rect entry_rect = cursor.cut_top(30);
+        expand_current_scroll_view(entry_rect);
+        ui_button(entry_rect.inset(2), "", {});
+        widgets += 1;
+    }
+    return widgets;
+}
+
+// layers of opaque panels with buttons on each, like a few windows open over a full screen background
+static int64_t scene_stacked_panels(int64_t layers) {
+    int64_t widgets = 0;
+    Rect panel = full_screen_rect();
+    FOR (layer, 0, layers-1) {
+        UI_PUSH_ID(layer);
+        DRAW_PUSH_LAYER(layer * 10);
+        draw_quad(panel, v4(0.1f * (float)(layer % 8), 0.2f, 0.25f, 1));
+        // a header bar across the top, and a sidebar that overlaps it
+        draw_quad(panel.top_rect_unscaled(40), v4(0.3f, 0.3f, 0.35f, 1));
+        draw_quad(panel.left_rect_unscaled(200), v4(0.2f, 0.2f, 0.22f, 1));
+        Rect cursor = panel.inset(50);
+        FOR (i, 0, 39) {
+            UI_PUSH_ID(i);
+            ui_button(cursor.cut_top(20).inset(1), "", {});
+            widgets += 1;
+        }
+        panel = panel.inset(60);
+    }
+    return widgets;
+}
+
+// a long list in a scroll view, where almost every row is scrolled out of view
+static int64_t scene_scroll_list(int64_t n) {
+    Text_Settings settings = {};
+    settings.font   = bench_font;
+    settings.valign = Text_VAlign::CENTER;
+    settings.halign = Text_HAlign::LEFT;
+    settings.color  = v4(1, 1, 1, 1);
+    Rect content_rect = {};
+    push_scroll_view(full_screen_rect().inset(20), "scroll list", SCROLL_VIEW_VERTICAL, &content_rect);
+    defer (pop_scroll_view());
+    Rect cursor = content_rect;
+    FOR (i, 0, n-1) {
+        Rect row_rect = cursor.cut_top(30);
+        expand_current_scroll_view(row_rect);
+        draw_quad(row_rect.inset(1), v4(0.2f, 0.2f, 0.2f, 1));
+        ui_text(row_rect, tprint("row %lld", (long long)i), settings);
+    }
+    return 1;
+}
+
+static int64_t scene_nested_scroll_views(int64_t depth) {
+    return nested_scroll_views(full_screen_rect().inset(20), depth);
+}
+
+static int64_t scene_deep_id_stacks(int64_t n) {
+    const int64_t depth = 32;
+    int64_t columns = 50;
+    float w = sapp_widthf() / columns;
+    float h = sapp_heightf() / (float)(n / columns + 1);
+    FOR (i, 0, n-1) {
+        FOR (level, 0, depth-1) {
+            if (level % 2 == 0) ui_push_id("panel section");
+            else                ui_push_id(level);
+        }
+        UI_PUSH_ID(i);
+        float x = (i % columns) * w;
+        float y = (i / columns) * h;
+        ui_button({{x, y}, {x + w, y + h}}, "button", {});
+        FOR (level, 0, depth-1) {
+            ui_pop_id();
+        }
+    }
+    return n;
+}
+
+struct Bench_Scene {
+    const char *name;
+    int64_t (*build)(int64_t);
+    int64_t param;
+    bool needs_font;
+    bool instanced; // draw_use_instancing for this scene
+    bool serial;    // turns off draw_parallel_vertex_generation, to compare with the scene after it
+    bool cpu_clip;  // draw_clip_on_cpu for this scene
+    bool overdraw;  // draw_eliminate_overdraw for this scene
+    bool retain;    // draw_retain_vertices for this scene, otherwise it's left at its default of off
+};
+
+static Bench_Scene bench_scenes[] = {
+    {"buttons 1k",                            scene_buttons,             1000,   false, false, false, false, false, false},
+    {"buttons 10k",                           scene_buttons,             10000,  false, false, false, false, false, false},
+    {"buttons 100k",                          scene_buttons,             100000, false, false, false, false, false, false},
+    {"quads 100k",                            scene_quads,               100000, false, false, false, false, false, false},
+    {"quads 100k (instanced)",                scene_quads,               100000, false, true,  false, false, false, false},
+    {"text labels 1k",                        scene_text_labels,         1000,   true,  false, false, false, false, false},
+    {"text labels 10k",                       scene_text_labels,         10000,  true,  false, false, false, false, false},
+    {"text labels 10k (retained)",            scene_text_labels,         10000,  true,  false, false, false, false, true},
+    {"text labels 10k (instanced)",           scene_text_labels,         10000,  true,  true,  false, false, false, false},
+    // ~550k glyphs
+    {"text labels 50k (serial)",              scene_text_labels,         50000,  true,  false, true,  false, false, false},
+    {"text labels 50k",                       scene_text_labels,         50000,  true,  false, false, false, false, false},
+    {"labeled buttons 1k",                    scene_labeled_buttons,     1000,   true,  false, false, false, false, false},
+    {"labeled buttons 1k (retained)",         scene_labeled_buttons,     1000,   true,  false, false, false, false, true},
+    {"nested scroll views (d=6)",             scene_nested_scroll_views, 6,      false, false, false, false, false, false},
+    {"nested scroll views (d=6, cpu clip)",   scene_nested_scroll_views, 6,      false, false, false, true,  false, false},
+    {"stacked panels (8)",                    scene_stacked_panels,      8,      false, false, false, false, false, false},
+    {"stacked panels (8, overdraw pass)",     scene_stacked_panels,      8,      false, false, false, false, true,  false},
+    {"scroll list 10k",                       scene_scroll_list,         10000,  true,  false, false, false, false, false},
+    {"deep id stacks 1k (d=32)",              scene_deep_id_stacks,      1000,   false, false, false, false, false, false},
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+enum Bench_Phase {
+    PHASE_NEW_FRAME,
+    PHASE_BUILD,
+    PHASE_END_FRAME,
+    PHASE_FLUSH,
+    PHASE_TOTAL,
+    PHASE_COUNT,
+};
+
+static const char *bench_phase_names[PHASE_COUNT] = {
+    "ui_new_frame",
+    "scene",
+    "ui_end_frame",
+    "draw_flush",
+    "total",
+};
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    if (x < y) return -1;
+    if (x > y) return 1;
+    return 0;
+}
+
+// nearest-rank percentile of already sorted samples
+static double percentile(List<double> sorted, double p) {
+    int64_t rank = (int64_t)(p / 100.0 * (double)sorted.count + 0.5);
+    rank = IMAX(1, IMIN(sorted.count, rank));
+    return sorted[rank-1];
+}
+
+static void run_scene(Bench_Scene *scene, int64_t frames) {
+    const int64_t warmup_frames = 10;
+    List<double> samples[PHASE_COUNT];
+    FOR (phase, 0, PHASE_COUNT-1) {
+        samples[phase] = make_list<double>(default_allocator(), frames);
+    }
+
+    int64_t widgets = 0;
+    int64_t temp_bytes = 0;
+    Draw_Stats draw_stats = {};
+    UI_Stats ui_stats = {};
+    Allocation_Stats allocations_before = {};
+    FOR (frame, 0, warmup_frames + frames - 1) {
+        if (frame == warmup_frames) {
+            allocations_before = default_allocator_stats;
+        }
+        temp_arena->reset();
+
+        // sweep the mouse around so the hot widget keeps changing
+        HMM_Vec2 old_mouse = mouse_screen_position;
+        float t = (float)frame / 60.0f;
+        mouse_screen_position = v2(sapp_widthf() * (0.5f + 0.45f * cos_turns(t * 0.5f)), sapp_heightf() * (0.5f + 0.45f * sin_turns(t * 0.7f)));
+        mouse_screen_delta = mouse_screen_position - old_mouse;
+
+        uint64_t start = stm_now();
+        uint64_t lap = start;
+        double times[PHASE_COUNT] = {};
+
+        ui_new_frame(1.0f / 60.0f);
+        draw_update();
+        times[PHASE_NEW_FRAME] = stm_ms(stm_laptime(&lap));
+
+        widgets = scene->build(scene->param);
+        times[PHASE_BUILD] = stm_ms(stm_laptime(&lap));
+
+        ui_end_frame();
+        times[PHASE_END_FRAME] = stm_ms(stm_laptime(&lap));
+
+        sg_pass_action pass_action = {};
+        sg_begin_default_pass(&pass_action, sapp_width(), sapp_height());
+        draw_flush();
+        sg_end_pass();
+        sg_commit();
+        times[PHASE_FLUSH] = stm_ms(stm_laptime(&lap));
+        times[PHASE_TOTAL] = stm_ms(stm_since(start));
+
+        draw_stats = draw_get_last_flush_stats();
+        ui_stats = ui_get_last_frame_stats();
+        temp_bytes = temp_arena->cursor - temp_arena->start;
+        if (frame >= warmup_frames) {
+            FOR (phase, 0, PHASE_COUNT-1) {
+                samples[phase].add(times[phase]);
+            }
+        }
+    }
+    Allocation_Stats allocations_after = default_allocator_stats;
+
+    printf("%s: %lld widgets (%lld awake), %lld commands (%lld KB), %lld vertices, %lld instances (%lld KB uploaded), %lld batches, %lld draw calls\n",
+           scene->name, (long long)widgets, (long long)ui_stats.awake_widgets, (long long)draw_stats.commands,
+           (long long)(draw_stats.command_bytes / 1024), (long long)draw_stats.vertices,
+           (long long)draw_stats.instances, (long long)(draw_stats.bytes_uploaded / 1024), (long long)draw_stats.batches, (long long)draw_stats.draw_calls);
+    printf("    batch breaks:");
+    FOR (reason, 0, BATCH_BREAK_REASON_COUNT-1) {
+        printf(" %s %lld", batch_break_reason_names[reason], (long long)draw_stats.batch_breaks[reason]);
+    }
+    printf("\n");
+    printf("    sokol calls: %lld apply_pipeline, %lld apply_uniforms, %lld apply_bindings, %lld apply_scissor_rect, %lld append_buffer, %lld draw\n",
+           (long long)draw_stats.pipeline_applies, (long long)draw_stats.uniform_applies, (long long)draw_stats.binding_applies,
+           (long long)draw_stats.scissor_applies, (long long)draw_stats.buffer_appends, (long long)draw_stats.draw_calls);
+    printf("    culled: %lld commands, %lld glyphs\n", (long long)draw_stats.culled_commands, (long long)draw_stats.culled_glyphs);
+    printf("    overdraw: %lld quads occluded, %lld trimmed, %lld pixels saved\n", (long long)draw_stats.occluded_quads,
+           (long long)draw_stats.trimmed_quads, (long long)draw_stats.occluded_pixels);
+    printf("    retained: %lld regions reused, %lld regenerated, %lld uploads skipped\n", (long long)draw_stats.reused_regions,
+           (long long)draw_stats.regenerated_regions, (long long)draw_stats.skipped_uploads);
+    printf("    %-14s %9s %9s %9s %9s   (ms)\n", "phase", "p50", "p90", "p99", "max");
+    FOR (phase, 0, PHASE_COUNT-1) {
+        List<double> sorted = samples[phase];
+        qsort(sorted.data, sorted.count, sizeof(double), compare_doubles);
+        printf("    %-14s %9.4f %9.4f %9.4f %9.4f\n", bench_phase_names[phase],
+               percentile(sorted, 50), percentile(sorted, 90), percentile(sorted, 99), sorted[sorted.count-1]);
+    }
+    printf("    heap: %.1f allocations/frame, %.1f KB/frame   temp arena: %lld KB/frame\n\n",
+           (double)(allocations_after.allocations - allocations_before.allocations) / (double)frames,
+           (double)(allocations_after.bytes_allocated - allocations_before.bytes_allocated) / 1024.0 / (double)frames,
+           (long long)(temp_bytes / 1024));
+
+    FOR (phase, 0, PHASE_COUNT-1) {
+        free(default_allocator(), samples[phase].data);
+    }
+
+    // run an empty frame so this scene's widgets are swept before the next scene starts
+    temp_arena->reset();
+    ui_new_frame(1.0f / 60.0f);
+    ui_end_frame();
+    ui_new_frame(1.0f / 60.0f);
+    ui_end_frame();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv) {
+    int64_t frames = 300;
+    const char *filter = nullptr;
+    if (argc > 1) frames = IMAX(1, atoll(argv[1]));
+    if (argc > 2) filter = argv[2];
+
+    temp_arena = bootstrap_arena(default_allocator(), 64 * 1024 * 1024);
+
+    stm_setup();
+    sg_desc desc = {};
+    sg_setup(&desc);
+    ui_init();
+    draw_init();
+    init_worker_threads(-1);
+
+    FILE *font_file = fopen("resources/fonts/roboto.ttf", "rb");
+    if (font_file != nullptr) {
+        fclose(font_file);
+        bench_font = load_font_from_file("resources/fonts/roboto.ttf", 24);
+    }
+
+    printf("%dx%d, %lld frames per scene, %lld worker threads\n\n", bench_screen_width, bench_screen_height, (long long)frames,
+           (long long)get_worker_thread_count());
+    for (Bench_Scene &scene : bench_scenes) {
+        if (filter != nullptr && strstr(scene.name, filter) == nullptr) {
+            continue;
+        }
+        if (scene.needs_font && bench_font == nullptr) {
+            printf("%s: skipped, run from the repo root so resources/fonts/roboto.ttf can be found\n\n", scene.name);
+            continue;
+        }
+        draw_use_instancing = scene.instanced;
+        draw_parallel_vertex_generation = !scene.serial;
+        draw_clip_on_cpu = scene.cpu_clip;
+        draw_eliminate_overdraw = scene.overdraw;
+        draw_retain_vertices = scene.retain;
+        run_scene(&scene, frames);
+    }
+
+    sg_shutdown();
+}
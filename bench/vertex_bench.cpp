@@ -0,0 +1,151 @@
+// microbenchmark for vertex emission: draw_expand_quads() on its own and draw_flush() on frames of quads and text,
+// each with draw_use_simd off and on. reports vertices per second.
+//
+// built along with the other benchmarks by bench/build.sh and build_bench.bat, once for SSE2 and once with AVX2
+// (vertex_bench_avx2). run from the repo root so resources/fonts/roboto.ttf can be found.
+//
+// the worker pool can only be started once, so scaling across threads is measured by running it once per thread
+// count: `vertex_bench 1`, `vertex_bench 2`, `vertex_bench 4`, `vertex_bench 8`. the count includes the calling
+// thread. with no argument it uses every core.
+
+#include "core.h"
+#include "draw.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void report(const char *name, int64_t vertices, uint64_t ticks) {
+    double seconds = stm_sec(ticks);
+    printf("  %-28s %8.3f ms  %8.1f M vertices/s\n", name, seconds * 1000.0, (double)vertices / seconds / 1000000.0);
+}
+
+#define BENCH_ITERATIONS 20
+
+// small enough to stay in cache, like the batches draw_flush() expands, so this measures the kernel and not memory
+#define EXPAND_QUADS      4096
+#define EXPAND_ITERATIONS 2000
+
+static void bench_expand(Draw_Instance *quads, Vertex *out) {
+    // the first pass faults the output in
+    draw_expand_quads(quads, EXPAND_QUADS, out);
+    uint64_t start = stm_now();
+    FOR (it, 0, EXPAND_ITERATIONS-1) {
+        draw_expand_quads(quads, EXPAND_QUADS, out);
+    }
+    report(draw_use_simd ? "simd" : "scalar", EXPAND_QUADS * 4 * EXPAND_ITERATIONS, stm_since(start));
+}
+
+static void build_quads(int64_t n) {
+    int64_t columns = 400;
+    float w = sapp_widthf() / columns;
+    float h = sapp_heightf() / (float)(n / columns + 1);
+    FOR (i, 0, n-1) {
+        float x = (i % columns) * w;
+        float y = (i / columns) * h;
+        draw_quad(v2(x, y), v2(x + w * 0.9f, y + h * 0.9f), v4(1, (float)(i & 255) / 255.0f, 0.5f, 1));
+    }
+}
+
+static void build_text(Font *font, int64_t n) {
+    int64_t columns = 20;
+    float w = sapp_widthf() / columns;
+    float h = sapp_heightf() / (float)(n / columns + 1);
+    FOR (i, 0, n-1) {
+        float x = (i % columns) * w;
+        float y = (i / columns) * h;
+        draw_text(tprint("label %lld", (long long)i), v2(x, y), font, v4(1, 1, 1, 1));
+    }
+}
+
+// only the flush is timed, the commands are rebuilt outside of it every frame
+static void bench_flush(Font *font, int64_t n) {
+    int64_t vertices = 0;
+    uint64_t ticks = 0;
+    FOR (it, 0, BENCH_ITERATIONS) {
+        temp_arena->reset();
+        draw_update();
+        if (font != nullptr) build_text(font, n);
+        else                 build_quads(n);
+        sg_pass_action pass_action = {};
+        sg_begin_default_pass(&pass_action, sapp_width(), sapp_height());
+        uint64_t start = stm_now();
+        draw_flush();
+        if (it > 0) {
+            ticks += stm_since(start);
+            vertices += draw_get_last_flush_stats().vertices;
+        }
+        sg_end_pass();
+        sg_commit();
+    }
+    report(draw_use_simd ? "simd" : "scalar", vertices, ticks);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv) {
+    temp_arena = bootstrap_arena(default_allocator(), 64 * 1024 * 1024);
+
+    stm_setup();
+    sg_desc desc = {};
+    sg_setup(&desc);
+    draw_init();
+    int64_t worker_count = -1;
+    if (argc > 1) {
+        int64_t threads = atoll(argv[1]);
+        if (threads < 1) {
+            printf("usage: vertex_bench [threads]\n");
+            return 1;
+        }
+        worker_count = threads - 1;
+    }
+    init_worker_threads(worker_count);
+    // every frame is the same, so retained vertices would skip the generation this is here to measure
+    draw_retain_vertices = false;
+
+#if SIMD_AVX2
+    const char *simd_name = "avx2";
+#elif SIMD_SSE2
+    const char *simd_name = "sse2";
+#else
+    const char *simd_name = "no simd";
+#endif
+    printf("%s, %lld worker threads\n\n", simd_name, (long long)get_worker_thread_count());
+
+    List<Draw_Instance> quads = make_list<Draw_Instance>(default_allocator(), EXPAND_QUADS);
+    FOR (i, 0, EXPAND_QUADS-1) {
+        float x = (float)(i % 1000);
+        float y = (float)(i / 1000);
+        uint16_t u = (uint16_t)(i * 37);
+        uint16_t v = (uint16_t)(i * 91);
+        quads.add({{x, y}, {x + 8, y + 12}, {u, v}, {(uint16_t)(u + 500), (uint16_t)(v + 700)}, (uint32_t)i * 2654435761u});
+    }
+    List<Vertex> out = make_list<Vertex>(default_allocator(), EXPAND_QUADS * 4);
+    out.add_count(EXPAND_QUADS * 4);
+
+    printf("draw_expand_quads, %d quads:\n", EXPAND_QUADS);
+    FOR (simd, 0, 1) {
+        draw_use_simd = simd != 0;
+        bench_expand(quads.data, out.data);
+    }
+
+    printf("draw_flush, 100k quads:\n");
+    FOR (simd, 0, 1) {
+        draw_use_simd = simd != 0;
+        bench_flush(nullptr, 100000);
+    }
+
+    FILE *font_file = fopen("resources/fonts/roboto.ttf", "rb");
+    if (font_file == nullptr) {
+        printf("text skipped, run from the repo root so resources/fonts/roboto.ttf can be found\n");
+    }
+    else {
+        fclose(font_file);
+        Font *font = load_font_from_file("resources/fonts/roboto.ttf", 24);
+        printf("draw_flush, 20k labels:\n");
+        FOR (simd, 0, 1) {
+            draw_use_simd = simd != 0;
+            bench_flush(font, 20000);
+        }
+    }
+
+    sg_shutdown();
+}
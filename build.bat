@@ -1 +1 @@
-cl /Zi src/main.cpp src/ui.cpp src/draw.cpp src/core.cpp src/sokol_impl.cpp src/stb.cpp /W4
\ No newline at end of file
+cl /Zi src/main.cpp src/ui.cpp src/draw.cpp src/profiler.cpp src/core.cpp src/sokol_impl.cpp src/stb.cpp /W4
\ No newline at end of file
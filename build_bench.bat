@@ -0,0 +1,4 @@
+cl /O2 /Zi /DNDEBUG /Isrc bench/ui_bench.cpp bench/bench_sokol_impl.cpp src/core.cpp src/ui.cpp src/draw.cpp src/profiler.cpp src/stb.cpp /W4 /Fe:ui_bench.exe
+cl /O2 /Zi /DNDEBUG /Isrc bench/vertex_bench.cpp bench/bench_sokol_impl.cpp src/core.cpp src/ui.cpp src/draw.cpp src/profiler.cpp src/stb.cpp /W4 /Fe:vertex_bench.exe
+cl /O2 /Zi /DNDEBUG /arch:AVX2 /Isrc bench/vertex_bench.cpp bench/bench_sokol_impl.cpp src/core.cpp src/ui.cpp src/draw.cpp src/profiler.cpp src/stb.cpp /W4 /Fe:vertex_bench_avx2.exe
+cl /O2 /Zi /DNDEBUG /Isrc bench/id_hash_bench.cpp src/core.cpp /W4 /Fe:id_hash_bench.execl /O2 /Zi /DNDEBUG /Isrc bench/sort_bench.cpp src/core.cpp /W4 /Fe:sort_bench.exe
@@ -2,8 +2,19 @@
 
 #include <cstdarg>
 
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 
+Allocation_Stats default_allocator_stats;
+
 Arena *bootstrap_arena(Allocator backing_allocator, int64_t capacity) {
     uint8_t *memory = (uint8_t *)alloc(backing_allocator, capacity, 16, false);
     Arena *arena = (Arena *)memory;
@@ -53,6 +64,392 @@ Arena *temp_arena;
 
 ////////////////////////////////////////////////////////////////////////////////
 
+static uint64_t radix_key(uint64_t value) { return value; }
+static uint64_t radix_key(Sort_Key key)   { return key.key; }
+
+template<typename T>
+static void radix_sort_impl(T *items, int64_t count, int64_t low_bit, int64_t high_bit, Allocator scratch_allocator) {
+    if (count <= 1 || low_bit >= high_bit) {
+        return;
+    }
+    assert(low_bit >= 0 && high_bit <= 64);
+
+    // split the key into as few passes of at most 11 bits as possible, so a 32 bit key takes 3 passes rather than 4
+    int64_t key_bits     = high_bit - low_bit;
+    int64_t pass_count   = (key_bits + 10) / 11;
+    int64_t digit_bits   = (key_bits + pass_count - 1) / pass_count;
+    int64_t bucket_count = 1ll << digit_bits;
+    uint64_t digit_mask  = (uint64_t)bucket_count - 1;
+
+    // histogram every digit in one pass
+    int64_t *histograms = (int64_t *)alloc(scratch_allocator, sizeof(int64_t) * pass_count * bucket_count, alignof(int64_t), true);
+    defer (free(scratch_allocator, histograms));
+    FOR (i, 0, count-1) {
+        uint64_t key = radix_key(items[i]) >> low_bit;
+        FOR (p, 0, pass_count-1) {
+            histograms[p * bucket_count + ((key >> (p * digit_bits)) & digit_mask)] += 1;
+        }
+    }
+
+    T *scratch = (T *)alloc(scratch_allocator, sizeof(T) * count, alignof(T), false);
+    defer (free(scratch_allocator, scratch));
+
+    T *src = items;
+    T *dst = scratch;
+    FOR (p, 0, pass_count-1) {
+        int64_t shift = low_bit + p * digit_bits;
+        int64_t *histogram = &histograms[p * bucket_count];
+        if (histogram[(radix_key(src[0]) >> shift) & digit_mask] == count) {
+            continue; // every key has the same digit here
+        }
+        int64_t offset = 0;
+        FOR (b, 0, bucket_count-1) {
+            int64_t c = histogram[b];
+            histogram[b] = offset;
+            offset += c;
+        }
+        FOR (i, 0, count-1) {
+            uint64_t digit = (radix_key(src[i]) >> shift) & digit_mask;
+            dst[histogram[digit]] = src[i];
+            histogram[digit] += 1;
+        }
+        T *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    if (src != items) {
+        memcpy(items, src, sizeof(T) * count);
+    }
+}
+
+void radix_sort(uint64_t *values, int64_t count, int64_t low_bit, int64_t high_bit, Allocator scratch_allocator) {
+    radix_sort_impl(values, count, low_bit, high_bit, scratch_allocator);
+}
+
+void radix_sort(Sort_Key *keys, int64_t count, Allocator scratch_allocator) {
+    radix_sort_impl(keys, count, 0, 64, scratch_allocator);
+}
+
+static int64_t bits_needed(uint64_t range) {
+    int64_t bits = 0;
+    while (bits < 64 && (range >> bits) != 0) {
+        bits += 1;
+    }
+    return bits;
+}
+
+// how layers map to small unsigned keys that sort the same way. there are usually only a handful of distinct layers,
+// so those get ranked. otherwise fall back to the offset from the smallest layer, computed in unsigned space so the
+// full int64 range fits without overflow. keys are made as they're packed rather than stored.
+#define MAX_RANKED_LAYERS 16
+
+struct Layer_Keys {
+    int64_t distinct[MAX_RANKED_LAYERS];
+    int64_t distinct_count; // past MAX_RANKED_LAYERS when layers are keyed by offset
+    int64_t min_layer;
+    int64_t bits;
+};
+
+// also finds the serial range, so the inputs are only read once before packing
+static Layer_Keys make_layer_keys(int64_t *layers, int64_t *serials, int64_t count, int64_t *min_serial, int64_t *max_serial) {
+    Layer_Keys result = {};
+    result.distinct[0] = layers[0];
+    result.distinct_count = 1;
+    result.min_layer = layers[0];
+    int64_t max_layer = layers[0];
+    int64_t last_layer = layers[0];
+    *min_serial = serials[0];
+    *max_serial = serials[0];
+    FOR (i, 1, count-1) {
+        int64_t layer = layers[i];
+        *min_serial = IMIN(*min_serial, serials[i]);
+        *max_serial = IMAX(*max_serial, serials[i]);
+        result.min_layer = IMIN(result.min_layer, layer);
+        max_layer = IMAX(max_layer, layer);
+        if (layer == last_layer || result.distinct_count > MAX_RANKED_LAYERS) {
+            continue;
+        }
+        last_layer = layer;
+        bool found = false;
+        FOR (d, 0, result.distinct_count-1) {
+            found |= result.distinct[d] == layer;
+        }
+        if (!found) {
+            if (result.distinct_count == MAX_RANKED_LAYERS) {
+                result.distinct_count += 1; // too many, stop looking
+                continue;
+            }
+            result.distinct[result.distinct_count] = layer;
+            result.distinct_count += 1;
+        }
+    }
+    if (result.distinct_count > MAX_RANKED_LAYERS) result.bits = bits_needed((uint64_t)max_layer - (uint64_t)result.min_layer);
+    else                                          result.bits = bits_needed((uint64_t)(result.distinct_count - 1));
+    return result;
+}
+
+// insertion sort that gives up once it has moved more than budget values. what it leaves is still a permutation, with
+// equal values in the order they started in.
+static bool insertion_sort_within_budget(uint64_t *values, int64_t count, int64_t budget) {
+    FOR (i, 1, count-1) {
+        uint64_t value = values[i];
+        int64_t j = i;
+        while (j > 0 && values[j-1] > value) {
+            values[j] = values[j-1];
+            j -= 1;
+            budget -= 1;
+        }
+        values[j] = value;
+        if (budget < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t layer_key(Layer_Keys *keys, int64_t layer) {
+    if (keys->distinct_count > MAX_RANKED_LAYERS) {
+        return (uint64_t)layer - (uint64_t)keys->min_layer;
+    }
+    // a layer's rank is how many distinct layers are below it. counting is branch-free, which matters because
+    // layers often alternate (a button under a drag-drop item, say)
+    uint64_t rank = 0;
+    FOR (d, 0, keys->distinct_count-1) {
+        rank += keys->distinct[d] < layer;
+    }
+    return rank;
+}
+
+List<int64_t> sort_by_layer_and_serial(int64_t *layers, int64_t *serials, int64_t count, Allocator allocator) {
+    List<int64_t> result = make_list<int64_t>(allocator, count);
+    if (count == 0) {
+        return result;
+    }
+
+    int64_t min_serial = 0;
+    int64_t max_serial = 0;
+    Layer_Keys layer_keys = make_layer_keys(layers, serials, count, &min_serial, &max_serial);
+    int64_t layer_bits  = layer_keys.bits;
+    int64_t serial_bits = bits_needed((uint64_t)max_serial - (uint64_t)min_serial);
+    int64_t index_bits  = bits_needed((uint64_t)(count - 1));
+
+    int64_t *order = result.add_count(count);
+    if (layer_bits + serial_bits + index_bits <= 64) {
+        // the common case: layer, serial and the original index all fit in one word. the index sits in the
+        // low bits and starts out ascending, so only the layer/serial bits need sorting and it stays stable.
+        uint64_t *values = (uint64_t *)alloc(allocator, sizeof(uint64_t) * count, alignof(uint64_t), false);
+        defer (free(allocator, values));
+        // commands mostly arrive in order, in which case there's nothing to sort
+        bool sorted = true;
+        uint64_t previous = 0;
+        FOR (i, 0, count-1) {
+            uint64_t serial = (uint64_t)serials[i] - (uint64_t)min_serial;
+            uint64_t key = (layer_bits == 0 ? 0 : (layer_key(&layer_keys, layers[i]) << serial_bits)) | serial;
+            values[i] = (key << index_bits) | (uint64_t)i;
+            sorted &= values[i] >= previous;
+            previous = values[i];
+        }
+        if (!sorted) {
+            // serials mostly ascend within a layer, with the odd one moved by draw_set_next_serial(). so when the
+            // layers are ranked, grouping by layer with a single pass usually leaves only a few values to insert
+            // into place. the full sort is still there for when that turns out to be too many.
+            bool done = false;
+            if (layer_bits > 0 && layer_keys.distinct_count <= MAX_RANKED_LAYERS) {
+                radix_sort(values, count, index_bits + serial_bits, index_bits + serial_bits + layer_bits, allocator);
+                done = insertion_sort_within_budget(values, count, count);
+            }
+            if (!done) {
+                radix_sort(values, count, index_bits, index_bits + layer_bits + serial_bits, allocator);
+            }
+        }
+        uint64_t index_mask = (1ull << index_bits) - 1;
+        FOR (i, 0, count-1) {
+            order[i] = (int64_t)(values[i] & index_mask);
+        }
+        return result;
+    }
+
+    Sort_Key *keys = (Sort_Key *)alloc(allocator, sizeof(Sort_Key) * count, alignof(Sort_Key), false);
+    defer (free(allocator, keys));
+    if (layer_bits + serial_bits <= 64) {
+        // layer in the high bits, serial in the low bits
+        FOR (i, 0, count-1) {
+            uint64_t serial = (uint64_t)serials[i] - (uint64_t)min_serial;
+            keys[i].key = (layer_bits == 0 ? 0 : (layer_key(&layer_keys, layers[i]) << serial_bits)) | serial;
+            keys[i].index = i;
+        }
+        radix_sort(keys, count, allocator);
+    }
+    else {
+        // too wide to pack, so sort by serial and then stably by layer
+        FOR (i, 0, count-1) {
+            keys[i].key = (uint64_t)serials[i] - (uint64_t)min_serial;
+            keys[i].index = i;
+        }
+        radix_sort(keys, count, allocator);
+        FOR (i, 0, count-1) {
+            keys[i].key = layer_key(&layer_keys, layers[keys[i].index]);
+        }
+        radix_sort(keys, count, allocator);
+    }
+
+    FOR (i, 0, count-1) {
+        order[i] = keys[i].index;
+    }
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// the job the workers are pulling indices from. next is bumped atomically, the rest is only written by parallel_for()
+// under worker_lock while no worker is inside a job.
+struct Worker_Job {
+    Parallel_For_Proc proc;
+    void *user_data;
+    int64_t count;
+    volatile int64_t next;
+};
+
+static Worker_Job worker_job;
+static int64_t worker_thread_count;
+static bool in_parallel_for;
+// both only touched under worker_lock. a new generation hands out a new job, and parallel_for() returns once
+// workers_in_job is back to 0.
+static uint64_t worker_job_generation;
+static int64_t workers_in_job;
+
+#if defined(_WIN32)
+static SRWLOCK worker_lock = SRWLOCK_INIT;
+static CONDITION_VARIABLE worker_job_ready = CONDITION_VARIABLE_INIT;
+static CONDITION_VARIABLE worker_job_done = CONDITION_VARIABLE_INIT;
+
+static void lock_workers()                              { AcquireSRWLockExclusive(&worker_lock); }
+static void unlock_workers()                            { ReleaseSRWLockExclusive(&worker_lock); }
+static void wait_for_workers(CONDITION_VARIABLE *cond)  { SleepConditionVariableSRW(cond, &worker_lock, INFINITE, 0); }
+static void wake_workers(CONDITION_VARIABLE *cond)      { WakeAllConditionVariable(cond); }
+static int64_t atomic_fetch_increment(volatile int64_t *value) { return _InterlockedIncrement64(value) - 1; }
+#else
+static pthread_mutex_t worker_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_job_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t worker_job_done = PTHREAD_COND_INITIALIZER;
+
+static void lock_workers()                          { pthread_mutex_lock(&worker_lock); }
+static void unlock_workers()                        { pthread_mutex_unlock(&worker_lock); }
+static void wait_for_workers(pthread_cond_t *cond)  { pthread_cond_wait(cond, &worker_lock); }
+static void wake_workers(pthread_cond_t *cond)      { pthread_cond_broadcast(cond); }
+static int64_t atomic_fetch_increment(volatile int64_t *value) { return __atomic_fetch_add(value, 1, __ATOMIC_SEQ_CST); }
+#endif
+
+static void work_on_job() {
+    while (true) {
+        int64_t index = atomic_fetch_increment(&worker_job.next);
+        if (index >= worker_job.count) {
+            break;
+        }
+        worker_job.proc(worker_job.user_data, index);
+    }
+}
+
+static void worker_thread_loop() {
+    uint64_t seen_generation = 0;
+    while (true) {
+        lock_workers();
+        while (worker_job_generation == seen_generation) {
+            wait_for_workers(&worker_job_ready);
+        }
+        seen_generation = worker_job_generation;
+        workers_in_job += 1;
+        unlock_workers();
+
+        // a worker that wakes late finds every index taken and drops straight out
+        work_on_job();
+
+        lock_workers();
+        workers_in_job -= 1;
+        if (workers_in_job == 0) {
+            wake_workers(&worker_job_done);
+        }
+        unlock_workers();
+    }
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI worker_thread_proc(LPVOID) {
+    worker_thread_loop();
+    return 0;
+}
+#else
+static void *worker_thread_proc(void *) {
+    worker_thread_loop();
+    return nullptr;
+}
+#endif
+
+void init_worker_threads(int64_t count) {
+    assert(worker_thread_count == 0);
+    if (count < 0) {
+#if defined(_WIN32)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        count = (int64_t)info.dwNumberOfProcessors - 1;
+#else
+        count = (int64_t)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+#endif
+    }
+    FOR (i, 0, count-1) {
+#if defined(_WIN32)
+        HANDLE thread = CreateThread(nullptr, 0, worker_thread_proc, nullptr, 0, nullptr);
+        if (thread == nullptr) break;
+        CloseHandle(thread);
+#else
+        pthread_t thread;
+        if (pthread_create(&thread, nullptr, worker_thread_proc, nullptr) != 0) break;
+        pthread_detach(thread);
+#endif
+        worker_thread_count += 1;
+    }
+}
+
+int64_t get_worker_thread_count() {
+    return worker_thread_count;
+}
+
+void parallel_for(int64_t count, Parallel_For_Proc proc, void *user_data) {
+    if (worker_thread_count == 0 || count <= 1) {
+        FOR (i, 0, count-1) {
+            proc(user_data, i);
+        }
+        return;
+    }
+
+    assert(!in_parallel_for && "parallel_for() can't be nested");
+    in_parallel_for = true;
+    lock_workers();
+    // stragglers from the last job may still be reading it
+    while (workers_in_job > 0) {
+        wait_for_workers(&worker_job_done);
+    }
+    worker_job.proc = proc;
+    worker_job.user_data = user_data;
+    worker_job.count = count;
+    worker_job.next = 0;
+    worker_job_generation += 1;
+    wake_workers(&worker_job_ready);
+    unlock_workers();
+
+    work_on_job();
+
+    // every index has been handed out, so once the workers inside the job leave it everything has finished
+    lock_workers();
+    while (workers_in_job > 0) {
+        wait_for_workers(&worker_job_done);
+    }
+    unlock_workers();
+    in_parallel_for = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 bool String::operator ==(String b) {
     if (count != b.count) {
         return false;
@@ -74,7 +471,7 @@ uint8_t &String::operator [](int64_t index) {
     return data[index];
 }
 
-String tprint(char *format, ...) {
+String tprint(const char *format, ...) {
     va_list args;
 
     va_start(args, format);
@@ -12,6 +12,18 @@
 #pragma warning(disable : 4505) // unreferenced function with internal linkage has been removed
 #pragma warning(disable : 4996) // This function or variable may be unsafe. Consider using fopen_s instead.
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define SIMD_AVX2 1
+#include <immintrin.h>
+#endif
+#if defined(_M_X64)
+#include <intrin.h>
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 
 #define FOR(i, lo, hi) for (int64_t i = lo; i <= hi; i++)
@@ -138,6 +150,137 @@ static float cos_turns(float t) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// wyhash-style hashing, 8 bytes at a time. hash_mix() is the whole mixing step: a 64x64->128 bit multiply of
+// the two inputs with the halves xor'd together. hash_bytes() doesn't take a seed so that the hash of a string
+// can be computed once and then combined with whatever it's nested under, see ui_push_id(). hash_literal() is
+// the same hash in a form the compiler can evaluate, for string literals.
+
+#define HASH_SECRET_0 0xa0761d6478bd642fULL
+#define HASH_SECRET_1 0xe7037ed1a0b428dbULL
+#define HASH_SECRET_2 0x8ebc6af09c88c6e3ULL
+#define HASH_SECRET_3 0x589965cc75374cc3ULL
+
+static constexpr uint64_t hash_mix_constexpr(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t)((__uint128_t)a * b) ^ (uint64_t)(((__uint128_t)a * b) >> 64);
+#else
+    uint64_t a_lo = a & 0xffffffff, a_hi = a >> 32;
+    uint64_t b_lo = b & 0xffffffff, b_hi = b >> 32;
+    uint64_t lo_lo = a_lo * b_lo;
+    uint64_t hi_lo = a_hi * b_lo;
+    uint64_t lo_hi = a_lo * b_hi;
+    uint64_t hi_hi = a_hi * b_hi;
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    uint64_t lo = (cross << 32) | (lo_lo & 0xffffffff);
+    uint64_t hi = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    return lo ^ hi;
+#endif
+}
+
+static uint64_t hash_mix(uint64_t a, uint64_t b) {
+#if defined(_M_X64) && !defined(__SIZEOF_INT128__)
+    uint64_t hi;
+    uint64_t lo = _umul128(a, b, &hi);
+    return lo ^ hi;
+#else
+    return hash_mix_constexpr(a, b);
+#endif
+}
+
+static uint64_t hash_read8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static uint64_t hash_read4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint64_t hash_bytes(const void *data, int64_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t seed = HASH_SECRET_3;
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if (len <= 16) {
+        if (len >= 4) {
+            // two overlapping reads from each end cover every length from 4 to 16
+            int64_t middle = (len >> 3) << 2;
+            a = (hash_read4(p) << 32) | hash_read4(p + middle);
+            b = (hash_read4(p + len - 4) << 32) | hash_read4(p + len - 4 - middle);
+        }
+        else if (len > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+        }
+    }
+    else {
+        int64_t remaining = len;
+        while (remaining > 16) {
+            seed = hash_mix(hash_read8(p) ^ HASH_SECRET_1, hash_read8(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        a = hash_read8(p + remaining - 16);
+        b = hash_read8(p + remaining - 8);
+    }
+    return hash_mix(HASH_SECRET_1 ^ (uint64_t)len, hash_mix(a ^ HASH_SECRET_1, b ^ seed));
+}
+
+// reads little-endian like hash_read8()/hash_read4() do on the platforms we build for
+static constexpr uint64_t hash_read_literal(const char *p, int64_t size) {
+    uint64_t v = 0;
+    FOR (i, 0, size-1) {
+        v |= (uint64_t)(uint8_t)p[i] << (8 * i);
+    }
+    return v;
+}
+
+// must stay in step with hash_bytes()
+static constexpr uint64_t hash_literal(const char *p, int64_t len) {
+    uint64_t seed = HASH_SECRET_3;
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if (len <= 16) {
+        if (len >= 4) {
+            int64_t middle = (len >> 3) << 2;
+            a = (hash_read_literal(p, 4) << 32) | hash_read_literal(p + middle, 4);
+            b = (hash_read_literal(p + len - 4, 4) << 32) | hash_read_literal(p + len - 4 - middle, 4);
+        }
+        else if (len > 0) {
+            a = ((uint64_t)(uint8_t)p[0] << 16) | ((uint64_t)(uint8_t)p[len >> 1] << 8) | (uint64_t)(uint8_t)p[len - 1];
+        }
+    }
+    else {
+        int64_t remaining = len;
+        while (remaining > 16) {
+            seed = hash_mix_constexpr(hash_read_literal(p, 8) ^ HASH_SECRET_1, hash_read_literal(p + 8, 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        a = hash_read_literal(p + remaining - 16, 8);
+        b = hash_read_literal(p + remaining - 8, 8);
+    }
+    return hash_mix_constexpr(HASH_SECRET_1 ^ (uint64_t)len, hash_mix_constexpr(a ^ HASH_SECRET_1, b ^ seed));
+}
+
+// a constexpr function is only guaranteed to run at compile time where a constant is required, like a template
+// argument. HASH_LITERAL("name") is the hash of a string literal computed at compile time in every build.
+template<uint64_t HASH>
+struct Literal_Hash {
+    static constexpr uint64_t value = HASH;
+};
+
+#define HASH_LITERAL(literal) (Literal_Hash<hash_literal(literal, sizeof(literal) - 1)>::value)
+
+// folds v into h. v should already be well distributed, or be small integers, which the multiply spreads out.
+static uint64_t hash_combine(uint64_t h, uint64_t v) {
+    return hash_mix(h ^ HASH_SECRET_0, v ^ HASH_SECRET_2);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 enum Allocator_Mode {
     ALLOCATOR_MODE_ALLOC,
     ALLOCATOR_MODE_FREE,
@@ -162,15 +305,29 @@ static void free(Allocator allocator, void *ptr) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// running totals for the default allocator, diff them across a frame to see what it allocated
+struct Allocation_Stats {
+    int64_t allocations;
+    int64_t frees;
+    int64_t bytes_allocated;
+};
+
+extern Allocation_Stats default_allocator_stats;
+
 static void *default_allocator_proc(void *data, void *old_ptr, int64_t size, int64_t align, Allocator_Mode mode) {
     UNUSED(data);
     UNUSED(align);
     if (mode == ALLOCATOR_MODE_ALLOC) {
+        default_allocator_stats.allocations += 1;
+        default_allocator_stats.bytes_allocated += size;
         void *result = malloc(size);
         return result;
     }
     else {
         assert(mode == ALLOCATOR_MODE_FREE);
+        if (old_ptr != nullptr) {
+            default_allocator_stats.frees += 1;
+        }
         free(old_ptr);
         return nullptr;
     }
@@ -288,6 +445,109 @@ List<T> make_list(Allocator allocator, int64_t capacity = 8) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// handles are a slot index in the low POOL_SLOT_BITS and a generation in the rest. generations start at 1,
+// so a zero handle is never valid, and a handle to a slot that was freed (and maybe reused) resolves to nullptr.
+// a slot whose generation would pass POOL_MAX_GENERATION (4095 reuses) is retired rather than wrapped, so stale
+// handles to it stay invalid. that puts the pool's lifetime at about 4 billion removes.
+#define POOL_SLOT_BITS 20
+#define POOL_MAX_SLOTS (1 << POOL_SLOT_BITS)
+#define POOL_MAX_GENERATION ((1u << (32 - POOL_SLOT_BITS)) - 1)
+
+template<typename T, int64_t CHUNK_SIZE = 256>
+struct Pool {
+    List<T *> chunks; // objects never move once allocated, so pointers stay valid until they are removed
+    List<uint32_t> generations;
+    List<uint32_t> free_slots;
+    Allocator allocator;
+
+    uint32_t add(T **out_elem) {
+        uint32_t slot = 0;
+        if (free_slots.count > 0) {
+            slot = free_slots.pop();
+        }
+        else {
+            assert(generations.count < POOL_MAX_SLOTS);
+            slot = (uint32_t)generations.count;
+            generations.add(1);
+            if ((slot % CHUNK_SIZE) == 0) {
+                chunks.add((T *)alloc(allocator, sizeof(T) * CHUNK_SIZE, alignof(T), false));
+            }
+        }
+        T *elem = get_slot(slot);
+        memset(elem, 0, sizeof(T));
+        *out_elem = elem;
+        return (generations[slot] << POOL_SLOT_BITS) | slot;
+    }
+
+    static int64_t slot_of(uint32_t handle) {
+        return handle & (POOL_MAX_SLOTS - 1);
+    }
+
+    T *get(uint32_t handle) {
+        int64_t slot = slot_of(handle);
+        if (handle == 0 || slot >= generations.count || generations[slot] != (handle >> POOL_SLOT_BITS)) {
+            return nullptr;
+        }
+        return get_slot(slot);
+    }
+
+    T *get_slot(int64_t slot) {
+        return &chunks[slot / CHUNK_SIZE][slot % CHUNK_SIZE];
+    }
+
+    void remove(uint32_t handle) {
+        int64_t slot = slot_of(handle);
+        assert(get(handle) != nullptr);
+        if (generations[slot] == POOL_MAX_GENERATION) {
+            generations[slot] = 0; // retired, no handle has generation 0
+            return;
+        }
+        generations[slot] += 1;
+        free_slots.add((uint32_t)slot);
+    }
+};
+
+template<typename T, int64_t CHUNK_SIZE = 256>
+Pool<T, CHUNK_SIZE> make_pool(Allocator allocator) {
+    Pool<T, CHUNK_SIZE> result = {};
+    result.allocator = allocator;
+    result.chunks.allocator = allocator;
+    result.generations.allocator = allocator;
+    result.free_slots.allocator = allocator;
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct Sort_Key {
+    uint64_t key;
+    int64_t  index;
+};
+
+// stable ascending LSD radix sorts. digits that are the same for every key are skipped.
+// the uint64_t version only looks at bits [low_bit, high_bit), so callers can pack a payload into the low bits.
+void radix_sort(uint64_t *values, int64_t count, int64_t low_bit, int64_t high_bit, Allocator scratch_allocator);
+void radix_sort(Sort_Key *keys, int64_t count, Allocator scratch_allocator);
+
+// returns indices 0..count-1 ordered by (layers[i], serials[i]) ascending. equal pairs keep their original order.
+List<int64_t> sort_by_layer_and_serial(int64_t *layers, int64_t *serials, int64_t count, Allocator allocator);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// a fixed pool of worker threads for splitting a loop across cores. the calling thread works through the indices
+// too, so with no workers parallel_for() is just a loop. procs run concurrently and must not touch the temp arena,
+// the profiler or anything else that isn't thread-safe.
+typedef void (*Parallel_For_Proc)(void *user_data, int64_t index);
+
+// count < 0 starts one worker per core besides the calling thread. only call it once.
+void init_worker_threads(int64_t count);
+int64_t get_worker_thread_count();
+
+// calls proc(user_data, i) for every i in [0, count) and returns once they've all finished
+void parallel_for(int64_t count, Parallel_For_Proc proc, void *user_data);
+
+////////////////////////////////////////////////////////////////////////////////
+
 template<int64_t N, typename T>
 struct Array {
     T data[N];
@@ -339,7 +599,7 @@ struct String {
 #define STRING_COUNT_DATA(str) (int)(str).count, (str).data
 #define STRING_DATA_COUNT(str) (str).data, (int)(str).count
 
-String tprint(char* format, ...);
+String tprint(const char *format, ...);
 
 ////////////////////////////////////////////////////////////////////////////////
 
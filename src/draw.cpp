@@ -1,14 +1,32 @@
 #include "draw.h"
 #include "core.h"
 #include "ui.h"
+#include "profiler.h"
 
 static int64_t last_serial;
 
 static List<Draw_Command> commands;
+static List<uint64_t>     command_words; // the payloads of commands, in words so every payload is 8-byte aligned
 static List<Vertex>       vertices;
+static List<Draw_Instance> instances;
 
-static sg_buffer vertex_buffer;
-static int64_t   vertex_buffer_capacity;
+// how many quads or glyphs draw_flush() generates before uploading them
+#define DRAW_FLUSH_CHUNK_QUADS (1 << 15)
+// how draw_flush() splits vertex generation across the worker threads. commands are never split, so a long string
+// makes for a bigger job.
+#define DRAW_COUNT_JOB_COMMANDS  4096
+#define DRAW_GENERATE_JOB_QUADS  2048
+
+static sg_buffer quad_index_buffer;
+static int64_t   quad_index_buffer_quads;
+
+bool draw_use_instancing;
+bool draw_parallel_vertex_generation = true;
+bool draw_use_simd = true;
+bool draw_cull_commands = true;
+bool draw_clip_on_cpu;
+bool draw_eliminate_overdraw;
+bool draw_retain_vertices;
 
 static List<int64_t> pushed_layers;
 int64_t              current_draw_layer;
@@ -28,27 +46,233 @@ static sg_image white_image;
 static sg_sampler linear_clamp_sampler;
 static sg_sampler linear_repeat_sampler;
 
-static void maybe_resize_vertex_buffer(int64_t required) {
-    if (required <= vertex_buffer_capacity) {
-        return;
+static Draw_Stats last_flush_stats;
+static int64_t culled_commands;
+static int64_t culled_glyphs;
+
+// what culled draws hand back, so callers can still set fields on the result
+static Draw_Command culled_command;
+
+static_assert(sizeof(Vertex) == 16, "Vertex should stay packed");
+static_assert(sizeof(Draw_Instance) == 28, "Draw_Instance should stay packed, draw_expand_quads() loads its fields by offset");
+
+const char *batch_break_reason_names[BATCH_BREAK_REASON_COUNT] = {
+    "pipeline",
+    "scissor",
+    "font",
+};
+
+// vertex and instance data go through sg_append_buffer() so draw_flush() can upload a chunk at a time and be called
+// more than once a frame. sokol keeps its own copies of stream buffers for frames still in flight. a frame that
+// fills the ring spills into another buffer, and the next frame swaps them all for one buffer with room for that
+// whole frame plus half again, so the ring settles on a single buffer sized for the biggest frame seen.
+struct Stream_Buffer {
+    sg_buffer buffer;
+    int64_t size;
+};
+
+struct Stream_Ring {
+    const char *label;
+    List<Stream_Buffer> buffers;
+    int64_t current;          // the buffer being appended to this frame
+    int64_t bytes_this_frame;
+    // frames anything was appended in. the first append of a frame moves sokol on to another copy of the buffer, so
+    // data appended before is only still there to draw while this hasn't changed.
+    int64_t appended_frames;
+};
+
+static Stream_Ring vertex_ring;
+static Stream_Ring instance_ring;
+
+static void stream_ring_add_buffer(Stream_Ring *ring, int64_t size) {
+    sg_buffer_desc buffer_desc = {};
+    buffer_desc.size = (size_t)size;
+    buffer_desc.label = ring->label;
+    buffer_desc.usage = SG_USAGE_STREAM;
+    Stream_Buffer stream_buffer = {sg_make_buffer(&buffer_desc), size};
+    ring->buffers.add(stream_buffer);
+}
+
+static void stream_ring_new_frame(Stream_Ring *ring) {
+    if (ring->buffers.count > 1) {
+        FOR (i, 0, ring->buffers.count-1) {
+            sg_destroy_buffer(ring->buffers[i].buffer);
+        }
+        ring->buffers.reset();
+        stream_ring_add_buffer(ring, ring->bytes_this_frame + ring->bytes_this_frame / 2);
+    }
+    ring->current = 0;
+    ring->bytes_this_frame = 0;
+}
+
+// returns where the data landed in *out_buffer
+static int64_t stream_ring_append(Stream_Ring *ring, sg_range data, sg_buffer *out_buffer) {
+    while (ring->current < ring->buffers.count && sg_query_buffer_will_overflow(ring->buffers[ring->current].buffer, data.size)) {
+        ring->current += 1;
+    }
+    if (ring->current == ring->buffers.count) {
+        // as big as everything before it, so spilling doubles the ring
+        int64_t ring_size = 0;
+        FOR (i, 0, ring->buffers.count-1) {
+            ring_size += ring->buffers[i].size;
+        }
+        int64_t size = IMAX(IMAX(64 * 1024, (int64_t)data.size), ring_size);
+        stream_ring_add_buffer(ring, (size + 3) & ~3);
     }
-    if (vertex_buffer.id) {
-        sg_destroy_buffer(vertex_buffer);
+    *out_buffer = ring->buffers[ring->current].buffer;
+    if (ring->bytes_this_frame == 0) {
+        ring->appended_frames += 1;
+    }
+    ring->bytes_this_frame += ((int64_t)data.size + 3) & ~3;
+    return sg_append_buffer(*out_buffer, &data);
+}
+
+// where a chunk of quads was appended
+struct Quad_Upload {
+    sg_buffer buffer;
+    int64_t offset;
+};
+
+// draw_retain_vertices. the sorted commands are cut into regions wherever a command's hash happens to have its low
+// bits clear, so the cuts follow the content: adding or removing a command only moves the cuts next to it, and the
+// regions after it hash the same as last frame even though they've shifted. regions found in last frame's output are
+// copied from there instead of generated. sokol can't update part of a buffer, so a frame that changed anywhere still
+// appends every chunk, but when nothing changed and the ring hasn't been appended to since, last frame's buffers
+// still hold all of it and are drawn from as they are.
+#define DRAW_MAX_RETAINED_FLUSHES    4
+#define DRAW_RETAIN_MIN_REGION_QUADS 256
+#define DRAW_RETAIN_MAX_REGION_QUADS 4096
+#define DRAW_RETAIN_CUT_MASK         15
+
+struct Retained_Region {
+    uint64_t hash;
+    int64_t first_quad;
+    int64_t quad_count;
+    int64_t first; // sorted positions [first, end), only meaningful in the frame that cut the region
+    int64_t end;
+};
+
+struct Retained_Output {
+    List<Retained_Region> regions;
+    List<Vertex> vertices;
+    List<Draw_Instance> instances;
+    List<Quad_Upload> uploads; // one per chunk
+    bool instanced;
+    float screen_height;
+    int64_t ring_appended_frames; // the ring's appended_frames once the uploads were made
+};
+
+// one per draw_flush() of a frame, in the order they're called
+struct Retained_Flush {
+    Retained_Output previous;
+    Retained_Output current;
+    bool reuse_uploads; // nothing changed, so the chunks are drawn from previous.uploads
+};
+
+static Retained_Flush retained_flushes[DRAW_MAX_RETAINED_FLUSHES];
+static int64_t flushes_this_frame;
+
+// every quad and glyph is 4 vertices drawn as 0 1 2 0 2 3. sokol has no base vertex for indexed draws, so the indices
+// have to reach the last vertex of the frame rather than just the biggest batch. they never change, so the buffer is
+// immutable and only remade when a frame has more quads than it covers. returns the bytes uploaded.
+static int64_t maybe_resize_quad_index_buffer(int64_t required_quads) {
+    if (required_quads <= quad_index_buffer_quads) {
+        return 0;
+    }
+    int64_t quads = IMAX(quad_index_buffer_quads * 2, 1024);
+    while (quads < required_quads) {
+        quads *= 2;
+    }
+    List<uint32_t> indices = make_list<uint32_t>(temp(), quads * 6);
+    FOR (q, 0, quads-1) {
+        uint32_t *quad_indices = indices.add_count(6);
+        uint32_t v = (uint32_t)(q * 4);
+        quad_indices[0] = v + 0;
+        quad_indices[1] = v + 1;
+        quad_indices[2] = v + 2;
+        quad_indices[3] = v + 0;
+        quad_indices[4] = v + 2;
+        quad_indices[5] = v + 3;
+    }
+    if (quad_index_buffer.id) {
+        sg_destroy_buffer(quad_index_buffer);
     }
     sg_buffer_desc buffer_desc = {};
-    buffer_desc.size = sizeof(Vertex) * required;
-    buffer_desc.label = "draw vertices";
-    buffer_desc.usage = SG_USAGE_STREAM;
-    vertex_buffer = sg_make_buffer(&buffer_desc);
-    vertex_buffer_capacity = required;
+    buffer_desc.type = SG_BUFFERTYPE_INDEXBUFFER;
+    buffer_desc.data = {indices.data, sizeof(uint32_t) * indices.count};
+    buffer_desc.label = "quad indices";
+    quad_index_buffer = sg_make_buffer(&buffer_desc);
+    quad_index_buffer_quads = quads;
+    return sizeof(uint32_t) * indices.count;
+}
+
+// colors past 0..1 get clamped here instead of in the blend
+static uint32_t pack_color(HMM_Vec4 color) {
+    uint32_t r = (uint32_t)(FMIN(FMAX(color.X, 0.0f), 1.0f) * 255.0f + 0.5f);
+    uint32_t g = (uint32_t)(FMIN(FMAX(color.Y, 0.0f), 1.0f) * 255.0f + 0.5f);
+    uint32_t b = (uint32_t)(FMIN(FMAX(color.Z, 0.0f), 1.0f) * 255.0f + 0.5f);
+    uint32_t a = (uint32_t)(FMIN(FMAX(color.W, 0.0f), 1.0f) * 255.0f + 0.5f);
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+static uint16_t pack_uv(float uv) {
+    return (uint16_t)(FMIN(FMAX(uv, 0.0f), 1.0f) * 65535.0f + 0.5f);
 }
 
 sg_pipeline textured_pipeline;
-sg_pipeline text_pipeline;
+
+static sg_pipeline instanced_textured_pipeline;
+
+// 6 vertices per instance in the same 0 1 2 0 2 3 order as the quad index buffer, with corner 0 at min/uv_min
+// and corner 2 at max/uv_max
+static const char *instanced_vertex_shader_source = R"DONE(#version 300 es
+    layout(location=0) in vec4 in_rect;
+    layout(location=1) in vec4 in_uv_rect;
+    layout(location=2) in vec4 in_color;
+    out vec2 fs_uv;
+    out vec4 fs_color;
+    uniform mat4 mvp;
+    void main() {
+        int corner = gl_VertexID < 3 ? gl_VertexID : (gl_VertexID == 3 ? 0 : gl_VertexID - 1);
+        vec2 t = vec2((corner == 1 || corner == 2) ? 1.0 : 0.0, corner >= 2 ? 1.0 : 0.0);
+        gl_Position = mvp * vec4(mix(in_rect.xy, in_rect.zw, t), 0, 1);
+        fs_uv = mix(in_uv_rect.xy, in_uv_rect.zw, t);
+        fs_color = in_color;
+    }
+    )DONE";
+
+// the instanced twin of a pipeline made in draw_init(), same shader stage and blending with a per-instance layout
+static sg_pipeline make_instanced_pipeline(sg_shader_desc shader_desc, sg_pipeline_desc pipeline_desc) {
+    shader_desc.vs.source = instanced_vertex_shader_source;
+    pipeline_desc.shader = sg_make_shader(&shader_desc);
+    assert(pipeline_desc.shader.id != SG_INVALID_ID);
+    pipeline_desc.layout = {};
+    pipeline_desc.layout.buffers[0].step_func = SG_VERTEXSTEP_PER_INSTANCE;
+    pipeline_desc.layout.attrs[0].format = SG_VERTEXFORMAT_FLOAT4;
+    pipeline_desc.layout.attrs[1].format = SG_VERTEXFORMAT_USHORT4N;
+    pipeline_desc.layout.attrs[2].format = SG_VERTEXFORMAT_UBYTE4N;
+    pipeline_desc.index_type = SG_INDEXTYPE_NONE;
+    return sg_make_pipeline(&pipeline_desc);
+}
 
 void draw_init() {
     commands.allocator = default_allocator();
+    command_words.allocator = default_allocator();
     vertices.allocator = default_allocator();
+    instances.allocator = default_allocator();
+    vertex_ring.label = "draw vertices";
+    vertex_ring.buffers.allocator = default_allocator();
+    instance_ring.label = "draw instances";
+    instance_ring.buffers.allocator = default_allocator();
+    FOR (i, 0, DRAW_MAX_RETAINED_FLUSHES-1) {
+        Retained_Output *outputs[2] = {&retained_flushes[i].previous, &retained_flushes[i].current};
+        FOR (j, 0, 1) {
+            outputs[j]->regions.allocator = default_allocator();
+            outputs[j]->vertices.allocator = default_allocator();
+            outputs[j]->instances.allocator = default_allocator();
+            outputs[j]->uploads.allocator = default_allocator();
+        }
+    }
     pushed_layers.allocator = default_allocator();
     pushed_scissors.allocator = default_allocator();
     pushed_colors.allocator = default_allocator();
@@ -78,74 +302,25 @@ void draw_init() {
     linear_repeat_sampler_desc.wrap_v = SG_WRAP_REPEAT;
     linear_repeat_sampler = sg_make_sampler(&linear_repeat_sampler_desc);
 
-    // textured pipeline
+    // the one pipeline for quads and text. text multiplies by the glyph coverage in the atlas, and quads sample a
+    // white texel (white_image, or the white block in the font atlas they're batched with) so they come out solid.
     {
         sg_shader_desc shader_desc = {};
-        shader_desc.label = "simple shader";
+        shader_desc.label = "textured shader";
         shader_desc.attrs[0].sem_name = "POS";
         shader_desc.attrs[1].sem_name = "UV";
         shader_desc.attrs[2].sem_name = "COLOR";
         shader_desc.vs.uniform_blocks[0].size = sizeof(HMM_Mat4);
         shader_desc.vs.uniform_blocks[0].uniforms[0] = {"mvp", SG_UNIFORMTYPE_MAT4, 1};
         shader_desc.vs.source = R"DONE(#version 300 es
-            layout(location=0) in vec4 in_pos;
+            layout(location=0) in vec2 in_pos;
             layout(location=1) in vec2 in_uv;
             layout(location=2) in vec4 in_color;
             out vec2 fs_uv;
             out vec4 fs_color;
             uniform mat4 mvp;
             void main() {
-                gl_Position = mvp * in_pos;
-                fs_uv = in_uv;
-                fs_color = in_color;
-            }
-            )DONE";
-        shader_desc.fs.source = R"DONE(#version 300 es
-            precision mediump float;
-            in vec2 fs_uv;
-            in vec4 fs_color;
-            out vec4 FragColor;
-            void main() {
-                FragColor = fs_color;
-            }
-            )DONE";
-
-        sg_shader shd = sg_make_shader(&shader_desc);
-        assert(shd.id != SG_INVALID_ID);
-
-        sg_pipeline_desc pipeline_desc = {};
-        pipeline_desc.label = "textured pipeline";
-        pipeline_desc.shader = shd;
-        pipeline_desc.layout.attrs[0].format = SG_VERTEXFORMAT_FLOAT4;
-        pipeline_desc.layout.attrs[1].format = SG_VERTEXFORMAT_FLOAT4;
-        pipeline_desc.layout.attrs[2].format = SG_VERTEXFORMAT_FLOAT4;
-        pipeline_desc.blend_color = {1, 1, 1, 1},
-        pipeline_desc.colors[0].blend.enabled = true;
-        pipeline_desc.colors[0].blend.src_factor_rgb   = SG_BLENDFACTOR_SRC_ALPHA;
-        pipeline_desc.colors[0].blend.dst_factor_rgb   = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
-        pipeline_desc.colors[0].blend.src_factor_alpha = SG_BLENDFACTOR_SRC_ALPHA;
-        pipeline_desc.colors[0].blend.dst_factor_alpha = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
-        textured_pipeline = sg_make_pipeline(&pipeline_desc);
-    }
-
-    // text pipeline
-    {
-        sg_shader_desc shader_desc = {};
-        shader_desc.label = "text shader";
-        shader_desc.attrs[0].sem_name = "POS";
-        shader_desc.attrs[1].sem_name = "UV";
-        shader_desc.attrs[2].sem_name = "COLOR";
-        shader_desc.vs.uniform_blocks[0].size = sizeof(HMM_Mat4);
-        shader_desc.vs.uniform_blocks[0].uniforms[0] = {"mvp", SG_UNIFORMTYPE_MAT4, 1};
-        shader_desc.vs.source = R"DONE(#version 300 es
-            layout(location=0) in vec4 in_pos;
-            layout(location=1) in vec2 in_uv;
-            layout(location=2) in vec4 in_color;
-            out vec2 fs_uv;
-            out vec4 fs_color;
-            uniform mat4 mvp;
-            void main() {
-                gl_Position = mvp * in_pos;
+                gl_Position = mvp * vec4(in_pos, 0, 1);
                 fs_uv = in_uv;
                 fs_color = in_color;
             }
@@ -175,24 +350,30 @@ void draw_init() {
         assert(shd.id != SG_INVALID_ID);
 
         sg_pipeline_desc pipeline_desc = {};
-        pipeline_desc.label = "text pipeline";
+        pipeline_desc.label = "textured pipeline";
         pipeline_desc.shader = shd;
-        pipeline_desc.layout.attrs[0].format = SG_VERTEXFORMAT_FLOAT4;
-        pipeline_desc.layout.attrs[1].format = SG_VERTEXFORMAT_FLOAT4;
-        pipeline_desc.layout.attrs[2].format = SG_VERTEXFORMAT_FLOAT4;
+        pipeline_desc.layout.attrs[0].format = SG_VERTEXFORMAT_FLOAT2;
+        pipeline_desc.layout.attrs[1].format = SG_VERTEXFORMAT_USHORT2N;
+        pipeline_desc.layout.attrs[2].format = SG_VERTEXFORMAT_UBYTE4N;
+        pipeline_desc.index_type = SG_INDEXTYPE_UINT32;
         pipeline_desc.blend_color = {1, 1, 1, 1},
         pipeline_desc.colors[0].blend.enabled = true;
         pipeline_desc.colors[0].blend.src_factor_rgb   = SG_BLENDFACTOR_SRC_ALPHA;
         pipeline_desc.colors[0].blend.dst_factor_rgb   = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
         pipeline_desc.colors[0].blend.src_factor_alpha = SG_BLENDFACTOR_SRC_ALPHA;
         pipeline_desc.colors[0].blend.dst_factor_alpha = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
-        text_pipeline = sg_make_pipeline(&pipeline_desc);
+        textured_pipeline = sg_make_pipeline(&pipeline_desc);
+        pipeline_desc.label = "instanced textured pipeline";
+        instanced_textured_pipeline = make_instanced_pipeline(shader_desc, pipeline_desc);
     }
 }
 
 void draw_update() {
-    current_scissor_rect = full_screen_rect();
+    current_scissor_rect = {{0, 0}, {sapp_widthf(), sapp_heightf()}};
     current_color_multiplier = v4(1, 1, 1, 1);
+    stream_ring_new_frame(&vertex_ring);
+    stream_ring_new_frame(&instance_ring);
+    flushes_this_frame = 0;
 }
 
 int64_t draw_get_next_serial() {
@@ -230,72 +411,186 @@ void draw_pop_color_multiplier() {
     current_color_multiplier = pushed_colors.pop();
 }
 
-Rect draw_clip_rect_to_current_scissor(Rect rect) {
-    rect.min.X = FMAX(rect.min.X, current_scissor_rect.min.X);
-    rect.min.X = FMIN(rect.min.X, current_scissor_rect.max.X);
-    rect.min.Y = FMAX(rect.min.Y, current_scissor_rect.min.Y);
-    rect.min.Y = FMIN(rect.min.Y, current_scissor_rect.max.Y);
-    rect.max.X = FMIN(rect.max.X, current_scissor_rect.max.X);
-    rect.max.X = FMAX(rect.max.X, current_scissor_rect.min.X);
-    rect.max.Y = FMIN(rect.max.Y, current_scissor_rect.max.Y);
-    rect.max.Y = FMAX(rect.max.Y, current_scissor_rect.min.Y);
+static Rect clip_rect(Rect rect, Rect clip) {
+    rect.min.X = FMAX(rect.min.X, clip.min.X);
+    rect.min.X = FMIN(rect.min.X, clip.max.X);
+    rect.min.Y = FMAX(rect.min.Y, clip.min.Y);
+    rect.min.Y = FMIN(rect.min.Y, clip.max.Y);
+    rect.max.X = FMIN(rect.max.X, clip.max.X);
+    rect.max.X = FMAX(rect.max.X, clip.min.X);
+    rect.max.Y = FMIN(rect.max.Y, clip.max.Y);
+    rect.max.Y = FMAX(rect.max.Y, clip.min.Y);
     return rect;
 }
 
-void draw_push_scissor(Rect rect) {
-    pushed_scissors.add(current_scissor_rect);
-    rect = draw_clip_rect_to_current_scissor(rect);
+Rect draw_clip_rect_to_current_scissor(Rect rect) {
+    return clip_rect(rect, current_scissor_rect);
+}
+
+// queues a header for a command of this kind and makes room for payload_size bytes of payload behind it
+static Draw_Command *add_command(Draw_Command_Kind kind, int64_t payload_size) {
+    int64_t offset = command_words.count;
+    assert(offset < (1ll << 30));
+    command_words.add_count((payload_size + 7) / 8);
     Draw_Command *cmd = commands.add_count(1);
-    cmd->kind = Draw_Command_Kind::SCISSOR;
     cmd->layer = current_draw_layer;
     cmd->serial = draw_get_next_serial();
-    cmd->scissor.rect = rect;
+    cmd->payload = ((uint32_t)offset << 2) | (uint32_t)kind;
+    return cmd;
+}
+
+static Draw_Command_Kind command_kind(Draw_Command *cmd) {
+    return (Draw_Command_Kind)(cmd->payload & 3);
+}
+
+static Draw_Command_Quad *quad_payload(Draw_Command *cmd) {
+    assert(command_kind(cmd) == Draw_Command_Kind::QUAD);
+    return (Draw_Command_Quad *)&command_words.data[cmd->payload >> 2];
+}
+
+static Draw_Command_Text *text_payload(Draw_Command *cmd) {
+    assert(command_kind(cmd) == Draw_Command_Kind::TEXT);
+    return (Draw_Command_Text *)&command_words.data[cmd->payload >> 2];
+}
+
+static Draw_Command_Scissor *scissor_payload(Draw_Command *cmd) {
+    assert(command_kind(cmd) == Draw_Command_Kind::SCISSOR);
+    return (Draw_Command_Scissor *)&command_words.data[cmd->payload >> 2];
+}
+
+// only there when the text's clip is set
+static Rect *text_clip_rect(Draw_Command_Text *text) {
+    assert(text->clip);
+    return (Rect *)(text + 1);
+}
+
+void draw_push_scissor(Rect rect) {
+    pushed_scissors.add(current_scissor_rect);
+    rect = draw_clip_rect_to_current_scissor(rect);
     current_scissor_rect = rect;
+    Draw_Command *cmd = add_command(Draw_Command_Kind::SCISSOR, sizeof(Draw_Command_Scissor));
+    scissor_payload(cmd)->rect = rect;
 }
 
 void draw_pop_scissor() {
     current_scissor_rect = pushed_scissors.pop();
-    Draw_Command *cmd = commands.add_count(1);
-    cmd->kind = Draw_Command_Kind::SCISSOR;
-    cmd->layer = current_draw_layer;
-    cmd->serial = draw_get_next_serial();
-    cmd->scissor.rect = current_scissor_rect;
+    Draw_Command *cmd = add_command(Draw_Command_Kind::SCISSOR, sizeof(Draw_Command_Scissor));
+    scissor_payload(cmd)->rect = current_scissor_rect;
 }
 
 Draw_Command *draw_quad(Rect rect, HMM_Vec4 color) {
     return draw_quad(rect.min, rect.max, color);
 }
 
+static Draw_Command *cull_command() {
+    culled_commands += 1;
+    culled_command = {};
+    culled_command.serial = draw_get_next_serial();
+    return &culled_command;
+}
+
+static bool quad_outside(HMM_Vec2 min, HMM_Vec2 max, Rect clip) {
+    return FMAX(min.X, max.X) <= clip.min.X || FMIN(min.X, max.X) >= clip.max.X ||
+           FMAX(min.Y, max.Y) <= clip.min.Y || FMIN(min.Y, max.Y) >= clip.max.Y;
+}
+
+// only printable characters become glyphs
+static int64_t count_glyphs(String text) {
+    int64_t result = 0;
+    FOR (j, 0, text.count-1) {
+        unsigned char c = (unsigned char)text[j];
+        result += (c >= 32 && c < 128) ? 1 : 0;
+    }
+    return result;
+}
+
+// submission only culls against the framebuffer. which scissor a command ends up under depends on where it sorts, so
+// that cull waits for draw_flush(), see cull_to_scissors().
 Draw_Command *draw_quad(HMM_Vec2 min, HMM_Vec2 max, HMM_Vec4 color) {
-    Draw_Command *cmd = commands.add_count(1);
-    cmd->kind = Draw_Command_Kind::QUAD;
-    cmd->layer = current_draw_layer;
-    cmd->min = min;
-    cmd->max = max;
-    cmd->color = color * current_color_multiplier;
-    cmd->serial = draw_get_next_serial();
+    if (draw_cull_commands && quad_outside(min, max, {{0, 0}, {sapp_widthf(), sapp_heightf()}})) {
+        return cull_command();
+    }
+    Draw_Command *cmd = add_command(Draw_Command_Kind::QUAD, sizeof(Draw_Command_Quad));
     cmd->pipeline = textured_pipeline;
+    Draw_Command_Quad *quad = quad_payload(cmd);
+    quad->min = min;
+    quad->max = max;
+    quad->color = pack_color(color * current_color_multiplier);
     return cmd;
 }
 
+// narrows text to the glyphs that overlap clip, moving position to the first of them. returns false if none do. lays
+// the glyphs out the same way write_quads() does so the pen lands on exactly the same floats.
+static bool cull_text(String *text, HMM_Vec2 *position, Font *font, Rect clip) {
+    // +1s for the rounding of glyph corners to whole pixels
+    if (position->Y + font->glyph_top + 1 <= clip.min.Y || position->Y + font->glyph_bottom - 1 >= clip.max.Y) {
+        return false;
+    }
+    float reach = font->glyph_max_advance + 1;
+    if (position->X - reach >= clip.min.X && position->X + reach * (float)(text->count + 1) <= clip.max.X) {
+        return true;
+    }
+
+    int64_t first = -1;
+    int64_t end = text->count;
+    float first_x = 0;
+    float x = position->X;
+    FOR (j, 0, text->count-1) {
+        unsigned char c = (unsigned char)(*text)[j];
+        if (c < 32 || c >= 128) {
+            continue;
+        }
+        stbtt_bakedchar *b = &font->chars[c-32];
+        int round_x = (int)floor((x + b->xoff) + 0.5f);
+        if ((float)round_x >= clip.max.X) {
+            end = j;
+            break;
+        }
+        if (first == -1 && (float)(round_x + b->x1 - b->x0) > clip.min.X) {
+            first = j;
+            first_x = x;
+        }
+        x += b->xadvance;
+    }
+    if (first == -1) {
+        return false;
+    }
+    position->X = first_x;
+    *text = String(text->data + first, end - first);
+    return true;
+}
+
 Draw_Command *draw_text(String text, HMM_Vec2 position, Font *font, HMM_Vec4 color) {
-    Draw_Command *cmd = commands.add_count(1);
-    cmd->kind = Draw_Command_Kind::TEXT;
-    cmd->layer = current_draw_layer;
-    cmd->min = position;
-    cmd->max = position;
-    cmd->color = color * current_color_multiplier;
-    cmd->image = font->image;
-    cmd->pipeline = text_pipeline;
-    // cmd->sampler = linear_clamp_sampler;
-    cmd->text.font = font;
-    cmd->text.string = text;
-    cmd->text.position = position;
-    cmd->serial = draw_get_next_serial();
+    if (draw_cull_commands) {
+        String visible = text;
+        bool any_visible = cull_text(&visible, &position, font, {{0, 0}, {sapp_widthf(), sapp_heightf()}});
+        if (!any_visible) {
+            culled_glyphs += count_glyphs(text);
+            return cull_command();
+        }
+        if (visible.count != text.count) {
+            culled_glyphs += count_glyphs(text) - count_glyphs(visible);
+        }
+        text = visible;
+    }
+    Draw_Command *cmd = add_command(Draw_Command_Kind::TEXT, sizeof(Draw_Command_Text) + (draw_clip_on_cpu ? sizeof(Rect) : 0));
+    cmd->pipeline = textured_pipeline;
+    Draw_Command_Text *payload = text_payload(cmd);
+    payload->font = font;
+    payload->string = text;
+    payload->position = position;
+    payload->color = pack_color(color * current_color_multiplier);
+    // clip_to_scissors() narrows this to the text's scissor. if draw_clip_on_cpu is off again by then, the GPU scissor
+    // does that instead
+    payload->clip = draw_clip_on_cpu;
+    if (payload->clip) {
+        *text_clip_rect(payload) = {{0, 0}, {sapp_widthf(), sapp_heightf()}};
+    }
     return cmd;
 }
 
 Font *load_font_from_file(const char *filepath, int64_t size) {
+    PROFILE_FUNCTION();
     Font *result = all_fonts.add_count(1);
 
     FILE *file = fopen(filepath, "rb");
@@ -317,8 +612,12 @@ Font *load_font_from_file(const char *filepath, int64_t size) {
         if (font_bitmap != nullptr) free(default_allocator(), font_bitmap);
         font_bitmap = (uint8_t *)alloc(default_allocator(), dim * dim, size, true);
         stbtt_result = stbtt_BakeFontBitmap(ttf_data, 0, (float)size, font_bitmap, dim, dim, 32, 96, result->chars);
-    } while (stbtt_result <= 0);
+    } while (stbtt_result <= 0 || stbtt_result + 3 > dim); // room for the white block below the last row of glyphs
     defer (free(default_allocator(), font_bitmap));
+    // 3x3 so linear filtering at the middle texel only ever sees white
+    FOR (y, stbtt_result, stbtt_result + 2) {
+        memset(&font_bitmap[y * dim], 255, 3);
+    }
 
     stbtt_fontinfo font_info = {};
     stbtt_InitFont(&font_info, ttf_data, 0);
@@ -340,13 +639,30 @@ Font *load_font_from_file(const char *filepath, int64_t size) {
     result->ascender = (int64_t)((float)ascent * scale);
     result->descender = (int64_t)((float)descent * scale);
     result->line_height = (int64_t)((float)line_height * scale);
+    float inverse_dim = 1.0f / (float)dim;
+    result->white_uv[0] = pack_uv(1.5f * inverse_dim);
+    result->white_uv[1] = pack_uv(((float)stbtt_result + 1.5f) * inverse_dim);
+    result->glyph_top = 0;
+    result->glyph_bottom = 0;
+    result->glyph_max_advance = 0;
+    FOR (c, 0, 95) {
+        stbtt_bakedchar *b = &result->chars[c];
+        float width = (float)(b->x1 - b->x0);
+        result->glyph_top = FMAX(result->glyph_top, -b->yoff);
+        result->glyph_bottom = FMIN(result->glyph_bottom, -b->yoff - (float)(b->y1 - b->y0));
+        result->glyph_max_advance = FMAX(result->glyph_max_advance, FMAX(b->xadvance, FMAX(b->xoff + width, -b->xoff)));
+        result->packed_uvs[c][0] = pack_uv((float)b->x0 * inverse_dim);
+        result->packed_uvs[c][1] = pack_uv((float)b->y0 * inverse_dim);
+        result->packed_uvs[c][2] = pack_uv((float)b->x1 * inverse_dim);
+        result->packed_uvs[c][3] = pack_uv((float)b->y1 * inverse_dim);
+    }
     return result;
 }
 
 float calculate_text_width(String text, Font *font) {
     HMM_Vec2 position = {};
     FOR (i, 0, text.count-1) {
-        char c = text[i];
+        unsigned char c = (unsigned char)text[i];
         if (c >= 32 && c < 128) {
             stbtt_aligned_quad q;
             stbtt_GetBakedQuad(font->chars, (int)font->bitmap_dim, (int)font->bitmap_dim, c-32, &position.X, &position.Y, &q, 1);
@@ -355,134 +671,916 @@ float calculate_text_width(String text, Font *font) {
     return position.X;
 }
 
-static int compare_draw_commands(const void *_a, const void *_b) {
-    const Draw_Command *a = (const Draw_Command *)_a;
-    const Draw_Command *b = (const Draw_Command *)_b;
-    if (a->layer == b->layer) {
-        return (int)(a->serial - b->serial);
+// walks the sorted commands with the scissor each one is drawn with, dropping quads and text entirely outside it from
+// order and trimming text to the glyphs that overlap it
+static void cull_to_scissors(List<int64_t> *order) {
+    Rect scissor = {{0, 0}, {sapp_widthf(), sapp_heightf()}};
+    int64_t kept = 0;
+    FOR (i, 0, order->count-1) {
+        Draw_Command *cmd = &commands[(*order)[i]];
+        bool visible = true;
+        if (command_kind(cmd) == Draw_Command_Kind::SCISSOR) {
+            scissor = scissor_payload(cmd)->rect;
+        }
+        else if (command_kind(cmd) == Draw_Command_Kind::QUAD) {
+            Draw_Command_Quad *quad = quad_payload(cmd);
+            visible = !quad_outside(quad->min, quad->max, scissor);
+        }
+        else {
+            Draw_Command_Text *text = text_payload(cmd);
+            String string = text->string;
+            HMM_Vec2 position = text->position;
+            visible = cull_text(&string, &position, text->font, scissor);
+            if (!visible) {
+                last_flush_stats.culled_glyphs += count_glyphs(text->string);
+            }
+            else if (string.count != text->string.count) {
+                last_flush_stats.culled_glyphs += count_glyphs(text->string) - count_glyphs(string);
+                text->string = string;
+                text->position = position;
+            }
+        }
+        if (!visible) {
+            last_flush_stats.culled_commands += 1;
+            continue;
+        }
+        (*order)[kept] = (*order)[i];
+        kept += 1;
+    }
+    order->count = kept;
+}
+
+// does what the SCISSOR commands would have, for draw_clip_on_cpu. walks the sorted commands with the scissor each
+// one is drawn with, clipping quads to it and handing it to text, then drops the SCISSOR commands from order. text
+// submitted before draw_clip_on_cpu was turned on has no clip rect and goes unclipped for that frame.
+static void clip_to_scissors(List<int64_t> *order) {
+    Rect scissor = {{0, 0}, {sapp_widthf(), sapp_heightf()}};
+    int64_t kept = 0;
+    FOR (i, 0, order->count-1) {
+        Draw_Command *cmd = &commands[(*order)[i]];
+        if (command_kind(cmd) == Draw_Command_Kind::SCISSOR) {
+            scissor = scissor_payload(cmd)->rect;
+            continue;
+        }
+        if (command_kind(cmd) == Draw_Command_Kind::QUAD) {
+            Draw_Command_Quad *quad = quad_payload(cmd);
+            Rect clipped = clip_rect({quad->min, quad->max}, scissor);
+            quad->min = clipped.min;
+            quad->max = clipped.max;
+        }
+        else if (text_payload(cmd)->clip) {
+            *text_clip_rect(text_payload(cmd)) = scissor;
+        }
+        (*order)[kept] = (*order)[i];
+        kept += 1;
+    }
+    order->count = kept;
+}
+
+// how many of the biggest opaque quads eliminate_overdraw() tests everything under them against
+#define DRAW_MAX_OCCLUDERS 16
+
+static bool is_opaque_quad(Draw_Command *cmd) {
+    if (command_kind(cmd) != Draw_Command_Kind::QUAD || cmd->pipeline.id != textured_pipeline.id) {
+        return false;
+    }
+    Draw_Command_Quad *quad = quad_payload(cmd);
+    return (quad->color >> 24) == 255 && quad->min.X < quad->max.X && quad->min.Y < quad->max.Y;
+}
+
+static Rect intersect_rects(Rect a, Rect b) {
+    return {{FMAX(a.min.X, b.min.X), FMAX(a.min.Y, b.min.Y)}, {FMIN(a.max.X, b.max.X), FMIN(a.max.Y, b.max.Y)}};
+}
+
+static bool rect_contains(Rect outer, Rect inner) {
+    return outer.min.X <= inner.min.X && outer.min.Y <= inner.min.Y && outer.max.X >= inner.max.X && outer.max.Y >= inner.max.Y;
+}
+
+// walks the sorted commands back to front keeping the biggest opaque quads seen so far, which draw over everything
+// before them. an opaque quad entirely inside one of those is dropped from order, and one that has a whole side
+// under one is trimmed back to its edge. quads are compared as they end up after their scissor. anything drawn
+// between the two is under the later quad too, so it doesn't matter what it is.
+static void eliminate_overdraw(List<int64_t> *order) {
+    // the scissor each command is drawn with. flushes start with the whole framebuffer
+    List<Rect> scissors = make_list<Rect>(temp(), order->count);
+    Rect scissor = {{0, 0}, {sapp_widthf(), sapp_heightf()}};
+    FOR (i, 0, order->count-1) {
+        Draw_Command *cmd = &commands[(*order)[i]];
+        if (command_kind(cmd) == Draw_Command_Kind::SCISSOR) {
+            scissor = scissor_payload(cmd)->rect;
+        }
+        scissors.add(scissor);
+    }
+
+    Rect occluders[DRAW_MAX_OCCLUDERS];
+    int64_t occluder_count = 0;
+    List<int64_t> kept = make_list<int64_t>(temp(), order->count);
+    FORR (i, 0, order->count-1) {
+        Draw_Command *cmd = &commands[(*order)[i]];
+        if (!is_opaque_quad(cmd)) {
+            kept.add((*order)[i]);
+            continue;
+        }
+        Draw_Command_Quad *quad = quad_payload(cmd);
+        Rect visible = intersect_rects({quad->min, quad->max}, scissors[i]);
+        if (visible.min.X >= visible.max.X || visible.min.Y >= visible.max.Y) {
+            kept.add((*order)[i]);
+            continue;
+        }
+
+        bool occluded = false;
+        Rect trimmed = visible;
+        FOR (o, 0, occluder_count-1) {
+            Rect b = occluders[o];
+            if (rect_contains(b, trimmed)) {
+                occluded = true;
+                break;
+            }
+            if (b.min.X <= trimmed.min.X && b.max.X >= trimmed.max.X) {
+                if (b.min.Y <= trimmed.min.Y && b.max.Y > trimmed.min.Y) trimmed.min.Y = b.max.Y;
+                if (b.max.Y >= trimmed.max.Y && b.min.Y < trimmed.max.Y) trimmed.max.Y = b.min.Y;
+            }
+            if (b.min.Y <= trimmed.min.Y && b.max.Y >= trimmed.max.Y) {
+                if (b.min.X <= trimmed.min.X && b.max.X > trimmed.min.X) trimmed.min.X = b.max.X;
+                if (b.max.X >= trimmed.max.X && b.min.X < trimmed.max.X) trimmed.max.X = b.min.X;
+            }
+        }
+        float visible_area = visible.width() * visible.height();
+        if (occluded) {
+            last_flush_stats.occluded_quads += 1;
+            last_flush_stats.occluded_pixels += (int64_t)visible_area;
+            continue;
+        }
+        if (trimmed.min != visible.min || trimmed.max != visible.max) {
+            // trimmed edges are inside the scissor, so moving just those edges of the command is enough
+            if (trimmed.min.X != visible.min.X) quad->min.X = trimmed.min.X;
+            if (trimmed.min.Y != visible.min.Y) quad->min.Y = trimmed.min.Y;
+            if (trimmed.max.X != visible.max.X) quad->max.X = trimmed.max.X;
+            if (trimmed.max.Y != visible.max.Y) quad->max.Y = trimmed.max.Y;
+            last_flush_stats.trimmed_quads += 1;
+            last_flush_stats.occluded_pixels += (int64_t)(visible_area - trimmed.width() * trimmed.height());
+        }
+        kept.add((*order)[i]);
+
+        // this quad hides whatever is under it too. keep the biggest ones
+        float area = trimmed.width() * trimmed.height();
+        int64_t slot = occluder_count;
+        if (occluder_count == DRAW_MAX_OCCLUDERS) {
+            slot = 0;
+            FOR (o, 1, occluder_count-1) {
+                if (occluders[o].width() * occluders[o].height() < occluders[slot].width() * occluders[slot].height()) slot = o;
+            }
+            if (occluders[slot].width() * occluders[slot].height() >= area) continue;
+        }
+        else {
+            occluder_count += 1;
+        }
+        occluders[slot] = trimmed;
+    }
+
+    // kept was filled back to front
+    order->reset();
+    FORR (i, 0, kept.count-1) {
+        order->add(kept[i]);
     }
-    return (int)(a->layer - b->layer);
 }
 
-struct Batch_Region {
-    int64_t  first_vertex;
-    int64_t  vertex_count;
+// a run of sorted commands that can share a draw call
+// quads fit into any batch, the first text in it picks the atlas and where the quads find white in it.
+struct Batch {
+    int64_t first; // into the sorted order
+    int64_t count;
     Draw_Command *cmd;
-    bool skip;
+    Font *font;    // nullptr until some text joins, quads alone draw with white_image
 };
 
-void draw_flush() {
-    if (commands.count == 0) return;
-
-    qsort(commands.data, commands.count, sizeof(Draw_Command), compare_draw_commands);
+// quads and glyphs are 4 vertices or one instance each, so draws are counted in quads for either mode. scissor
+// changes are queued as draws too so they land between the right draw calls.
+struct Batch_Draw {
+    Draw_Command *cmd;
+    Font *font;
+    int64_t first_quad;
+    int64_t quad_count;
+};
 
-    List<Batch_Region> batch_regions = make_list<Batch_Region>(temp());
-    FOR (i, 0, commands.count-1) {
-        Draw_Command *cmd = &commands[i];
-        Batch_Region region = {};
-        region.first_vertex = vertices.count;
-        region.cmd = cmd;
-
-        HMM_Vec2 p1 = cmd->min;
-        HMM_Vec2 p2 = {cmd->min.X, cmd->max.Y};
-        HMM_Vec2 p3 = cmd->max;
-        HMM_Vec2 p4 = {cmd->max.X, cmd->min.Y};
-
-        if (cmd->kind == Draw_Command_Kind::QUAD) {
-            Vertex *quad_vertices = vertices.add_count(6);
-            quad_vertices[0] = {{p1.X, p1.Y, 0, 1}, {0, 0}, cmd->color};
-            quad_vertices[1] = {{p3.X, p3.Y, 0, 1}, {0, 0}, cmd->color};
-            quad_vertices[2] = {{p2.X, p2.Y, 0, 1}, {0, 0}, cmd->color};
-            quad_vertices[3] = {{p1.X, p1.Y, 0, 1}, {0, 0}, cmd->color};
-            quad_vertices[4] = {{p4.X, p4.Y, 0, 1}, {0, 0}, cmd->color};
-            quad_vertices[5] = {{p3.X, p3.Y, 0, 1}, {0, 0}, cmd->color};
-        }
-        else if (cmd->kind == Draw_Command_Kind::TEXT) {
-            p1.Y = sapp_height() - p1.Y;
-            FOR (j, 0, cmd->text.string.count-1) {
-                char c = cmd->text.string[j];
-                if (c >= 32 && c < 128) {
-                    stbtt_aligned_quad q;
-                    stbtt_GetBakedQuad(cmd->text.font->chars, (int)cmd->text.font->bitmap_dim, (int)cmd->text.font->bitmap_dim, c-32, &p1.X, &p1.Y, &q, 1);
-                    q.y0 = sapp_height() - q.y0;
-                    q.y1 = sapp_height() - q.y1;
-                    Vertex *char_vertices = vertices.add_count(6);
-                    char_vertices[0] = {{q.x0, q.y1, 0, 1}, {q.s0, q.t1, 0, 0}, cmd->color};
-                    char_vertices[1] = {{q.x1, q.y0, 0, 1}, {q.s1, q.t0, 0, 0}, cmd->color};
-                    char_vertices[2] = {{q.x0, q.y0, 0, 1}, {q.s0, q.t0, 0, 0}, cmd->color};
-                    char_vertices[3] = {{q.x0, q.y1, 0, 1}, {q.s0, q.t1, 0, 0}, cmd->color};
-                    char_vertices[4] = {{q.x1, q.y1, 0, 1}, {q.s1, q.t1, 0, 0}, cmd->color};
-                    char_vertices[5] = {{q.x1, q.y0, 0, 1}, {q.s1, q.t0, 0, 0}, cmd->color};
-               }
+// quads a command turns into, 0 for scissors
+static int64_t count_quads(Draw_Command *cmd) {
+    if (command_kind(cmd) == Draw_Command_Kind::QUAD) {
+        return 1;
+    }
+    int64_t result = 0;
+    if (command_kind(cmd) == Draw_Command_Kind::TEXT) {
+        String string = text_payload(cmd)->string;
+        FOR (j, 0, string.count-1) {
+            unsigned char c = (unsigned char)string[j];
+            if (c >= 32 && c < 128) {
+                result += 1;
             }
         }
+    }
+    return result;
+}
+
+void draw_expand_quads(Draw_Instance *quads, int64_t count, Vertex *out) {
+    int64_t i = 0;
+    // corner uvs are the 16-bit lanes (s0 t0 s1 t0 | s1 t1 s0 t1) shuffled out of (s0 t0 s1 t1), interleaved with the
+    // color to make each vertex's back half. positions shuffle the same way out of (min max).
+#if SIMD_AVX2
+    if (draw_use_simd) {
+        for (; i + 2 <= count; i += 2) {
+            __m256 rect = _mm256_set_m128(_mm_loadu_ps(&quads[i+1].min.X), _mm_loadu_ps(&quads[i].min.X));
+            __m256i uv = _mm256_set_m128i(_mm_loadl_epi64((__m128i *)quads[i+1].uv_min), _mm_loadl_epi64((__m128i *)quads[i].uv_min));
+            __m256i color = _mm256_set_m128i(_mm_set1_epi32((int)quads[i+1].color), _mm_set1_epi32((int)quads[i].color));
+            uv = _mm256_unpacklo_epi64(uv, uv);
+            uv = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(uv, _MM_SHUFFLE(1, 2, 1, 0)), _MM_SHUFFLE(3, 0, 3, 2));
+            __m256i back01 = _mm256_unpacklo_epi32(uv, color);
+            __m256i back23 = _mm256_unpackhi_epi32(uv, color);
+            __m256i front01 = _mm256_castps_si256(_mm256_shuffle_ps(rect, rect, _MM_SHUFFLE(1, 2, 1, 0)));
+            __m256i front23 = _mm256_castps_si256(_mm256_shuffle_ps(rect, rect, _MM_SHUFFLE(3, 0, 3, 2)));
+            __m256i v0 = _mm256_unpacklo_epi64(front01, back01);
+            __m256i v1 = _mm256_unpackhi_epi64(front01, back01);
+            __m256i v2 = _mm256_unpacklo_epi64(front23, back23);
+            __m256i v3 = _mm256_unpackhi_epi64(front23, back23);
+            // each register holds a corner of both quads, regroup them into each quad's 64 bytes
+            __m256i *dst = (__m256i *)(out + i * 4);
+            _mm256_storeu_si256(dst + 0, _mm256_permute2x128_si256(v0, v1, 0x20));
+            _mm256_storeu_si256(dst + 1, _mm256_permute2x128_si256(v2, v3, 0x20));
+            _mm256_storeu_si256(dst + 2, _mm256_permute2x128_si256(v0, v1, 0x31));
+            _mm256_storeu_si256(dst + 3, _mm256_permute2x128_si256(v2, v3, 0x31));
+        }
+    }
+#endif
+#if SIMD_SSE2
+    if (draw_use_simd) {
+        for (; i < count; i++) {
+            __m128 rect = _mm_loadu_ps(&quads[i].min.X);
+            __m128i uv = _mm_loadl_epi64((__m128i *)quads[i].uv_min);
+            __m128i color = _mm_set1_epi32((int)quads[i].color);
+            uv = _mm_unpacklo_epi64(uv, uv);
+            uv = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(1, 2, 1, 0)), _MM_SHUFFLE(3, 0, 3, 2));
+            __m128i back01 = _mm_unpacklo_epi32(uv, color);
+            __m128i back23 = _mm_unpackhi_epi32(uv, color);
+            __m128i front01 = _mm_castps_si128(_mm_shuffle_ps(rect, rect, _MM_SHUFFLE(1, 2, 1, 0)));
+            __m128i front23 = _mm_castps_si128(_mm_shuffle_ps(rect, rect, _MM_SHUFFLE(3, 0, 3, 2)));
+            __m128i *dst = (__m128i *)(out + i * 4);
+            _mm_storeu_si128(dst + 0, _mm_unpacklo_epi64(front01, back01));
+            _mm_storeu_si128(dst + 1, _mm_unpackhi_epi64(front01, back01));
+            _mm_storeu_si128(dst + 2, _mm_unpacklo_epi64(front23, back23));
+            _mm_storeu_si128(dst + 3, _mm_unpackhi_epi64(front23, back23));
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        Draw_Instance *q = &quads[i];
+        Vertex *v = out + i * 4;
+        v[0] = {q->min,              {q->uv_min[0], q->uv_min[1]}, q->color};
+        v[1] = {{q->max.X, q->min.Y}, {q->uv_max[0], q->uv_min[1]}, q->color};
+        v[2] = {q->max,              {q->uv_max[0], q->uv_max[1]}, q->color};
+        v[3] = {{q->min.X, q->max.Y}, {q->uv_min[0], q->uv_max[1]}, q->color};
+    }
+}
+
+// quads and glyphs are resolved to Draw_Instances first. in instanced mode that's the output, otherwise they're
+// staged and expanded to vertices DRAW_STAGED_QUADS at a time.
+#define DRAW_STAGED_QUADS 256
+
+struct Quad_Writer {
+    Vertex *vertex_out;
+    Draw_Instance *instance_out;
+    Draw_Instance staged[DRAW_STAGED_QUADS];
+    int64_t staged_count;
+};
+
+static void flush_staged_quads(Quad_Writer *writer) {
+    draw_expand_quads(writer->staged, writer->staged_count, writer->vertex_out);
+    writer->vertex_out += writer->staged_count * 4;
+    writer->staged_count = 0;
+}
+
+static Draw_Instance *next_quad(Quad_Writer *writer) {
+    if (writer->instance_out != nullptr) {
+        return writer->instance_out++;
+    }
+    if (writer->staged_count == DRAW_STAGED_QUADS) {
+        flush_staged_quads(writer);
+    }
+    return &writer->staged[writer->staged_count++];
+}
+
+// cuts a resolved glyph down to clip. glyphs are baked 1:1, so a pixel trimmed off the quad is a texel trimmed off its
+// uvs. a glyph with nothing left collapses to a point rather than being dropped, so quad counts don't change.
+static void clip_glyph(Draw_Instance *glyph, stbtt_bakedchar *b, Font *font, Rect clip) {
+    HMM_Vec2 min = glyph->min; // bottom left, where texel row y1 is
+    HMM_Vec2 max = glyph->max;
+    if (min.X >= clip.min.X && max.X <= clip.max.X && min.Y >= clip.min.Y && max.Y <= clip.max.Y) {
+        return;
+    }
+    HMM_Vec2 clipped_min = {FMAX(min.X, clip.min.X), FMAX(min.Y, clip.min.Y)};
+    HMM_Vec2 clipped_max = {FMIN(max.X, clip.max.X), FMIN(max.Y, clip.max.Y)};
+    if (clipped_min.X >= clipped_max.X || clipped_min.Y >= clipped_max.Y) {
+        glyph->max = glyph->min;
+        return;
+    }
+    float inverse_dim = 1.0f / (float)font->bitmap_dim;
+    glyph->min = clipped_min;
+    glyph->max = clipped_max;
+    glyph->uv_min[0] = pack_uv(((float)b->x0 + (clipped_min.X - min.X)) * inverse_dim);
+    glyph->uv_min[1] = pack_uv(((float)b->y1 - (clipped_min.Y - min.Y)) * inverse_dim);
+    glyph->uv_max[0] = pack_uv(((float)b->x0 + (clipped_max.X - min.X)) * inverse_dim);
+    glyph->uv_max[1] = pack_uv(((float)b->y1 - (clipped_max.Y - min.Y)) * inverse_dim);
+}
+
+// resolves count_quads(cmd) quads into the writer
+static void write_quads(Draw_Command *cmd, Font *batch_font, float screen_height, Quad_Writer *writer) {
+    if (command_kind(cmd) == Draw_Command_Kind::QUAD) {
+        // white_image is white all over so any uv will do for it
+        Draw_Command_Quad *quad = quad_payload(cmd);
+        uint16_t white_u = batch_font != nullptr ? batch_font->white_uv[0] : 0;
+        uint16_t white_v = batch_font != nullptr ? batch_font->white_uv[1] : 0;
+        *next_quad(writer) = {quad->min, quad->max, {white_u, white_v}, {white_u, white_v}, quad->color};
+    }
+    else if (command_kind(cmd) == Draw_Command_Kind::TEXT) {
+        // stbtt_GetBakedQuad() with opengl_fillrule, inlined. stb_truetype lays out y-down, so the pen starts flipped
+        // and each glyph is flipped back as it's resolved.
+        Draw_Command_Text *text = text_payload(cmd);
+        Font *font = text->font;
+        float x = text->position.X;
+        float y = screen_height - text->position.Y;
+        FOR (j, 0, text->string.count-1) {
+            unsigned char c = (unsigned char)text->string[j];
+            if (c >= 32 && c < 128) {
+                stbtt_bakedchar *b = &font->chars[c-32];
+                int round_x = (int)floor((x + b->xoff) + 0.5f);
+                int round_y = (int)floor((y + b->yoff) + 0.5f);
+                float x0 = (float)round_x;
+                float x1 = (float)(round_x + b->x1 - b->x0);
+                float y0 = screen_height - (float)round_y;
+                float y1 = screen_height - (float)(round_y + b->y1 - b->y0);
+                x += b->xadvance;
+                uint16_t *uvs = font->packed_uvs[c-32];
+                Draw_Instance *glyph = next_quad(writer);
+                *glyph = {{x0, y1}, {x1, y0}, {uvs[0], uvs[3]}, {uvs[2], uvs[1]}, text->color};
+                if (text->clip) {
+                    clip_glyph(glyph, b, font, *text_clip_rect(text));
+                }
+           }
+        }
+    }
+}
+
+// shared by the vertex generation jobs. counting fills quad_offsets[i+1] with the quads of sorted position i, which
+// the prefix sum turns into where each command's quads start. every command then writes straight to its own spot in
+// the chunk, so jobs can run in any order and still produce what the serial loop would.
+struct Generation_Job {
+    int64_t first; // sorted positions [first, end)
+    int64_t end;
+    int64_t copy_from; // where a retained region's quads start in last frame's output, -1 to generate them instead
+};
 
-        region.vertex_count = vertices.count - region.first_vertex;
-        batch_regions.add(region);
+struct Vertex_Generation {
+    Draw_Command *commands;
+    int64_t *order;
+    int64_t command_count;
+    Font **fonts;              // the batch font of each sorted position
+    int64_t *quad_offsets;     // command_count+1 of them
+    uint64_t *command_hashes;  // filled by counting when retaining vertices, 0 for commands without quads
+    float screen_height;
+    // the chunk being generated
+    List<Generation_Job> jobs;
+    int64_t base_quad;
+    Vertex *vertices;
+    Draw_Instance *instances;
+    Vertex *previous_vertices;
+    Draw_Instance *previous_instances;
+};
+
+// covers everything write_quads() reads, so commands that hash the same come out as the same quads
+static uint64_t hash_command(Draw_Command *cmd, Font *batch_font) {
+    uint64_t result = hash_combine((uint64_t)command_kind(cmd), (uint64_t)(uintptr_t)batch_font);
+    if (command_kind(cmd) == Draw_Command_Kind::QUAD) {
+        Draw_Command_Quad *quad = quad_payload(cmd);
+        result = hash_combine(result, hash_bytes(quad, sizeof(HMM_Vec2) * 2));
+        result = hash_combine(result, quad->color);
     }
+    else if (command_kind(cmd) == Draw_Command_Kind::TEXT) {
+        Draw_Command_Text *text = text_payload(cmd);
+        result = hash_combine(result, hash_bytes(&text->position, sizeof(HMM_Vec2)));
+        result = hash_combine(result, text->color);
+        result = hash_combine(result, (uint64_t)(uintptr_t)text->font);
+        result = hash_combine(result, hash_bytes(text->string.data, text->string.count));
+        if (text->clip) {
+            result = hash_combine(result, hash_bytes(text_clip_rect(text), sizeof(Rect)));
+        }
+    }
+    return result;
+}
+
+static void count_quads_job(void *user_data, int64_t job) {
+    Vertex_Generation *gen = (Vertex_Generation *)user_data;
+    int64_t first = job * DRAW_COUNT_JOB_COMMANDS;
+    int64_t last = first + DRAW_COUNT_JOB_COMMANDS - 1;
+    if (last > gen->command_count-1) last = gen->command_count-1;
+    FOR (i, first, last) {
+        Draw_Command *cmd = &gen->commands[gen->order[i]];
+        int64_t quads = count_quads(cmd);
+        gen->quad_offsets[i+1] = quads;
+        if (gen->command_hashes != nullptr) {
+            gen->command_hashes[i] = quads > 0 ? hash_command(cmd, gen->fonts[i]) : 0;
+        }
+    }
+}
+
+static void generate_quads_job(void *user_data, int64_t index) {
+    Vertex_Generation *gen = (Vertex_Generation *)user_data;
+    Generation_Job *job = &gen->jobs[index];
+    // a job's commands are consecutive, so its quads are too
+    int64_t first_quad = gen->quad_offsets[job->first] - gen->base_quad;
+    if (job->copy_from >= 0) {
+        int64_t quads = gen->quad_offsets[job->end] - gen->quad_offsets[job->first];
+        if (gen->vertices != nullptr) memcpy(gen->vertices + first_quad * 4, gen->previous_vertices + job->copy_from * 4, sizeof(Vertex) * 4 * quads);
+        else                          memcpy(gen->instances + first_quad, gen->previous_instances + job->copy_from, sizeof(Draw_Instance) * quads);
+        return;
+    }
+    Quad_Writer writer;
+    writer.vertex_out = gen->vertices != nullptr ? gen->vertices + first_quad * 4 : nullptr;
+    writer.instance_out = gen->instances != nullptr ? gen->instances + first_quad : nullptr;
+    writer.staged_count = 0;
+    FOR (i, job->first, job->end-1) {
+        write_quads(&gen->commands[gen->order[i]], gen->fonts[i], gen->screen_height, &writer);
+    }
+    if (writer.instance_out == nullptr) {
+        flush_staged_quads(&writer);
+    }
+}
 
-    assert(batch_regions.count > 0);
-    Batch_Region *current_batch_region = &batch_regions[0];
-    FOR (i, 1, batch_regions.count-1) {
-        Batch_Region *region = &batch_regions[i];
-        bool can_batch = true;
-        if (region->cmd->kind != current_batch_region->cmd->kind) can_batch = false;
-        else if (region->cmd->image.id != current_batch_region->cmd->image.id) can_batch = false;
-        else if (region->cmd->pipeline.id != current_batch_region->cmd->pipeline.id) can_batch = false;
-        else if (region->cmd->kind == Draw_Command_Kind::SCISSOR) can_batch = false;
-        else if (region->cmd->kind == Draw_Command_Kind::TEXT && region->cmd->text.font != current_batch_region->cmd->text.font) can_batch = false;
+static void run_generation_jobs(int64_t count, Parallel_For_Proc proc, Vertex_Generation *gen) {
+    if (draw_parallel_vertex_generation) {
+        parallel_for(count, proc, gen);
+        return;
+    }
+    FOR (i, 0, count-1) {
+        proc(gen, i);
+    }
+}
 
-        if (can_batch) {
-            assert(region->cmd->kind != Draw_Command_Kind::QUAD || region->cmd->kind != Draw_Command_Kind::TEXT);
-            current_batch_region->vertex_count += region->vertex_count;
-            region->skip = true;
+// queues jobs of about DRAW_GENERATE_JOB_QUADS quads each for sorted positions [first, end)
+static void add_generation_jobs(Vertex_Generation *gen, int64_t first, int64_t end) {
+    Generation_Job job = {first, end, -1};
+    FOR (i, first, end-1) {
+        if (i+1 < end && gen->quad_offsets[i+1] - gen->quad_offsets[job.first] >= DRAW_GENERATE_JOB_QUADS) {
+            job.end = i+1;
+            gen->jobs.add(job);
+            job.first = i+1;
+        }
+    }
+    job.end = end;
+    gen->jobs.add(job);
+}
+
+// generates the quads of sorted positions [first, end) into vertices or instances, which hold nothing else yet
+static void generate_quads(Vertex_Generation *gen, int64_t first, int64_t end, bool instanced) {
+    int64_t quads = gen->quad_offsets[end] - gen->quad_offsets[first];
+    if (quads == 0) {
+        return;
+    }
+    gen->base_quad = gen->quad_offsets[first];
+    gen->vertices  = instanced ? nullptr : vertices.add_count(quads * 4);
+    gen->instances = instanced ? instances.add_count(quads) : nullptr;
+    gen->jobs.reset();
+    add_generation_jobs(gen, first, end);
+    run_generation_jobs(gen->jobs.count, generate_quads_job, gen);
+}
+
+// cuts the sorted commands into regions and fills retained->current with the whole flush's quads, copying the regions
+// last frame's output already has and generating the rest
+static void generate_retained_quads(Vertex_Generation *gen, Retained_Flush *retained, bool instanced) {
+    Retained_Output *previous = &retained->previous;
+    Retained_Output *current = &retained->current;
+    current->regions.reset();
+    current->uploads.reset();
+    current->instanced = instanced;
+    current->screen_height = gen->screen_height;
+    retained->reuse_uploads = false;
+
+    int64_t *quad_offsets = gen->quad_offsets;
+    Retained_Region region = {};
+    FOR (i, 0, gen->command_count-1) {
+        region.hash = hash_combine(region.hash, gen->command_hashes[i]);
+        int64_t quads = quad_offsets[i+1] - quad_offsets[region.first];
+        bool cut = quads >= DRAW_RETAIN_MIN_REGION_QUADS && gen->command_hashes[i] != 0 && (gen->command_hashes[i] & DRAW_RETAIN_CUT_MASK) == 0;
+        if (cut || quads >= DRAW_RETAIN_MAX_REGION_QUADS || i == gen->command_count-1) {
+            region.hash = hash_combine(region.hash, (uint64_t)quads);
+            region.first_quad = quad_offsets[region.first];
+            region.quad_count = quads;
+            region.end = i+1;
+            current->regions.add(region);
+            region = {};
+            region.first = i+1;
+        }
+    }
+
+    // last frame's quads only carry over if they were generated the same way
+    bool compatible = previous->instanced == instanced && previous->screen_height == gen->screen_height;
+    bool unchanged = compatible && previous->regions.count == current->regions.count;
+    for (int64_t r = 0; unchanged && r < current->regions.count; r++) {
+        unchanged = previous->regions[r].hash == current->regions[r].hash;
+    }
+    if (unchanged) {
+        // the same quads in the same places, so take last frame's lists rather than copying them
+        List<Vertex> swap_vertices = current->vertices;
+        current->vertices = previous->vertices;
+        previous->vertices = swap_vertices;
+        List<Draw_Instance> swap_instances = current->instances;
+        current->instances = previous->instances;
+        previous->instances = swap_instances;
+        last_flush_stats.reused_regions += current->regions.count;
+
+        Stream_Ring *ring = instanced ? &instance_ring : &vertex_ring;
+        retained->reuse_uploads = previous->ring_appended_frames == ring->appended_frames;
+        FOR (i, 0, previous->uploads.count-1) {
+            sg_buffer buffer = previous->uploads[i].buffer;
+            if (buffer.id != 0 && sg_query_buffer_state(buffer) != SG_RESOURCESTATE_VALID) {
+                retained->reuse_uploads = false;
+            }
+        }
+        return;
+    }
+
+    // hash to index table over last frame's regions, open addressing with the index plus one so 0 is empty
+    int64_t table_size = 16;
+    while (table_size < previous->regions.count * 2) {
+        table_size *= 2;
+    }
+    List<int64_t> table = make_list<int64_t>(temp(), table_size);
+    table.add_count(table_size);
+    if (compatible) {
+        FOR (r, 0, previous->regions.count-1) {
+            uint64_t slot = previous->regions[r].hash & (table_size-1);
+            while (table[slot] != 0) {
+                slot = (slot+1) & (table_size-1);
+            }
+            table[slot] = r+1;
+        }
+    }
+
+    int64_t total_quads = quad_offsets[gen->command_count];
+    current->vertices.reset();
+    current->instances.reset();
+    gen->base_quad = 0;
+    gen->vertices  = instanced ? nullptr : current->vertices.add_count(total_quads * 4);
+    gen->instances = instanced ? current->instances.add_count(total_quads) : nullptr;
+    gen->previous_vertices = previous->vertices.data;
+    gen->previous_instances = previous->instances.data;
+    gen->jobs.reset();
+    FOR (r, 0, current->regions.count-1) {
+        Retained_Region *cut = &current->regions[r];
+        if (cut->quad_count == 0) {
+            continue;
+        }
+        int64_t copy_from = -1;
+        uint64_t slot = cut->hash & (table_size-1);
+        while (table[slot] != 0) {
+            Retained_Region *match = &previous->regions[table[slot]-1];
+            if (match->hash == cut->hash && match->quad_count == cut->quad_count) {
+                copy_from = match->first_quad;
+                break;
+            }
+            slot = (slot+1) & (table_size-1);
+        }
+        if (copy_from >= 0) {
+            Generation_Job job = {cut->first, cut->end, copy_from};
+            gen->jobs.add(job);
+            last_flush_stats.reused_regions += 1;
         }
         else {
-            current_batch_region = region;
+            add_generation_jobs(gen, cut->first, cut->end);
+            last_flush_stats.regenerated_regions += 1;
         }
     }
+    run_generation_jobs(gen->jobs.count, generate_quads_job, gen);
+}
 
-    maybe_resize_vertex_buffer(vertices.count);
-    sg_update_buffer(vertex_buffer, {vertices.data, sizeof(Vertex) * vertices.count});
+// what submission last handed to sokol, so calls that wouldn't change anything can be skipped. sg_apply_pipeline()
+// invalidates the bindings and uniforms, so both go again after it. reset by every draw_flush() since the caller can
+// touch sokol state in between.
+struct Draw_State_Cache {
+    sg_pipeline pipeline;
+    sg_bindings bindings;
+    bool bindings_valid;
+    bool uniforms_valid;
+    HMM_Mat4 screen_proj;
+    Rect scissor;
+    bool scissor_valid;
+    Rect pending_scissor;
+    bool has_pending_scissor;
+};
+
+static Draw_State_Cache draw_state;
+
+static void apply_pending_scissor() {
+    if (!draw_state.has_pending_scissor) {
+        return;
+    }
+    Rect sr = draw_state.pending_scissor;
+    if (!draw_state.scissor_valid || sr.min != draw_state.scissor.min || sr.max != draw_state.scissor.max) {
+        sg_apply_scissor_rectf(sr.min.X, sr.min.Y, sr.width(), sr.height(), false);
+        last_flush_stats.scissor_applies += 1;
+        draw_state.scissor = sr;
+        draw_state.scissor_valid = true;
+    }
+    draw_state.has_pending_scissor = false;
+}
+
+static Quad_Upload upload_quads(void *data, int64_t quad_count, bool instanced) {
+    Quad_Upload upload = {};
+    if (quad_count == 0) {
+        return upload;
+    }
+    int64_t size = instanced ? sizeof(Draw_Instance) * quad_count : sizeof(Vertex) * 4 * quad_count;
+    upload.offset = stream_ring_append(instanced ? &instance_ring : &vertex_ring, {data, (size_t)size}, &upload.buffer);
+    last_flush_stats.buffer_appends += 1;
+    last_flush_stats.bytes_uploaded += size;
+    return upload;
+}
+
+// uploads the quads of sorted positions [first, end), from vertices or instances or else the retained output, and
+// returns where they went. a flush that's the same as last frame's hands back where they went then.
+static Quad_Upload upload_chunk(Vertex_Generation *gen, Retained_Flush *retained, int64_t first, int64_t end, bool instanced) {
+    PROFILE_BEGIN("upload");
+    int64_t quads = gen->quad_offsets[end] - gen->quad_offsets[first];
+    Quad_Upload upload = {};
+    if (retained == nullptr) {
+        upload = upload_quads(instanced ? (void *)instances.data : (void *)vertices.data, quads, instanced);
+        vertices.reset();
+        instances.reset();
+    }
+    else if (retained->reuse_uploads) {
+        assert(retained->current.uploads.count < retained->previous.uploads.count);
+        upload = retained->previous.uploads[retained->current.uploads.count];
+        last_flush_stats.skipped_uploads += 1;
+    }
+    else {
+        int64_t first_quad = gen->quad_offsets[first];
+        void *data = instanced ? (void *)(retained->current.instances.data + first_quad) : (void *)(retained->current.vertices.data + first_quad * 4);
+        upload = upload_quads(data, quads, instanced);
+    }
+    if (retained != nullptr) {
+        retained->current.uploads.add(upload);
+    }
+    if (instanced) {
+        last_flush_stats.instances += quads;
+    }
+    else {
+        last_flush_stats.vertices += quads * 4;
+        last_flush_stats.bytes_uploaded += maybe_resize_quad_index_buffer(quads);
+    }
+    PROFILE_END();
+    return upload;
+}
+
+static bool uses_custom_pipeline(Draw_Command *cmd) {
+    return cmd->pipeline.id != 0 && cmd->pipeline.id != textured_pipeline.id;
+}
 
-    FOR (i, 0, batch_regions.count-1) {
-        Batch_Region *region = &batch_regions[i];
-        if (region->skip) {
+// issues the queued draws for a chunk uploaded by upload_chunk()
+static void submit_pending_draws(List<Batch_Draw> *pending, bool instanced, Quad_Upload upload) {
+    PROFILE_BEGIN("submission");
+    FOR (i, 0, pending->count-1) {
+        Batch_Draw *draw = &(*pending)[i];
+        if (command_kind(draw->cmd) == Draw_Command_Kind::SCISSOR) {
+            // only the last of a run of scissor changes matters, so wait for a draw before applying it
+            draw_state.pending_scissor = scissor_payload(draw->cmd)->rect;
+            draw_state.has_pending_scissor = true;
             continue;
         }
-        if (region->cmd->pipeline.id != 0) {
-            sg_apply_pipeline(region->cmd->pipeline);
-            HMM_Mat4 screen_proj = HMM_Orthographic_LH_ZO(0, sapp_widthf(), 0, sapp_heightf(), -1000, 1000);
-            sg_apply_uniforms(SG_SHADERSTAGE_VS, 0, SG_RANGE(screen_proj));
+        apply_pending_scissor();
+        if (draw->cmd->pipeline.id != 0) {
+            sg_pipeline pipeline = draw->cmd->pipeline;
+            if (instanced) {
+                assert(pipeline.id == textured_pipeline.id && "draw_flush() draws flushes with custom pipelines using vertices");
+                pipeline = instanced_textured_pipeline;
+            }
+            if (pipeline.id != draw_state.pipeline.id) {
+                sg_apply_pipeline(pipeline);
+                last_flush_stats.pipeline_applies += 1;
+                draw_state.pipeline = pipeline;
+                draw_state.bindings_valid = false;
+                draw_state.uniforms_valid = false;
+            }
+            if (!draw_state.uniforms_valid) {
+                sg_apply_uniforms(SG_SHADERSTAGE_VS, 0, SG_RANGE(draw_state.screen_proj));
+                last_flush_stats.uniform_applies += 1;
+                draw_state.uniforms_valid = true;
+            }
             sg_bindings bindings = {};
-            bindings.vertex_buffers[0] = vertex_buffer;
-            if (region->cmd->image.id != 0) {
-                bindings.fs.images[0] = region->cmd->image;
-                bindings.fs.samplers[0] = linear_clamp_sampler;
+            bindings.vertex_buffers[0] = upload.buffer;
+            if (instanced) {
+                // no base instance in sokol, so each draw starts the buffer at its own first instance
+                bindings.vertex_buffer_offsets[0] = (int)(upload.offset + draw->first_quad * sizeof(Draw_Instance));
             }
-            sg_apply_bindings(&bindings);
-        }
-        switch (region->cmd->kind) {
-            case Draw_Command_Kind::QUAD: {
-                sg_draw((int)region->first_vertex, (int)region->vertex_count, 1);
-                break;
+            else {
+                // indices count from the binding offset, so every chunk's quads start at index 0
+                bindings.vertex_buffer_offsets[0] = (int)upload.offset;
+                bindings.index_buffer = quad_index_buffer;
             }
-            case Draw_Command_Kind::TEXT: {
-                sg_draw((int)region->first_vertex, (int)region->vertex_count, 1);
-                break;
+            bindings.fs.images[0] = draw->font != nullptr ? draw->font->image : white_image;
+            bindings.fs.samplers[0] = linear_clamp_sampler;
+            if (!draw_state.bindings_valid || memcmp(&bindings, &draw_state.bindings, sizeof(bindings)) != 0) {
+                sg_apply_bindings(&bindings);
+                last_flush_stats.binding_applies += 1;
+                draw_state.bindings = bindings;
+                draw_state.bindings_valid = true;
             }
-            case Draw_Command_Kind::SCISSOR: {
-                Rect sr = region->cmd->scissor.rect;
-                sg_apply_scissor_rectf(sr.min.X, sr.min.Y, sr.width(), sr.height(), false);
-                break;
+        }
+        if (instanced) sg_draw(0, 6, (int)draw->quad_count);
+        else           sg_draw((int)(draw->first_quad * 6), (int)(draw->quad_count * 6), 1);
+        last_flush_stats.draw_calls += 1;
+    }
+    PROFILE_END();
+
+    pending->reset();
+}
+
+// can be called more than once a frame, e.g. once per pass. vertices are uploaded every DRAW_FLUSH_CHUNK_QUADS quads so
+// the cpu-side lists stay small and the upload of one chunk overlaps generating the next. a batch that straddles a
+// chunk boundary is split into two draw calls. every command's quad count is known before any are generated, so each
+// chunk is generated in parallel_for() jobs writing straight into the list that gets uploaded. with
+// draw_retain_vertices the whole flush is generated up front into its retained output instead, and the chunks are
+// uploaded from there.
+void draw_flush() {
+    PROFILE_FUNCTION();
+    last_flush_stats = {};
+    last_flush_stats.culled_commands = culled_commands;
+    last_flush_stats.culled_glyphs = culled_glyphs;
+    culled_commands = 0;
+    culled_glyphs = 0;
+    if (commands.count == 0) return;
+    last_flush_stats.commands = commands.count;
+    last_flush_stats.command_bytes = sizeof(Draw_Command) * commands.count + sizeof(uint64_t) * command_words.count;
+    draw_state = {};
+    draw_state.screen_proj = HMM_Orthographic_LH_ZO(0, sapp_widthf(), 0, sapp_heightf(), -1000, 1000);
+
+    PROFILE_BEGIN("sort");
+    // sort an index array by (layer, serial) rather than moving the commands themselves
+    List<int64_t> layers  = make_list<int64_t>(temp(), commands.count);
+    List<int64_t> serials = make_list<int64_t>(temp(), commands.count);
+    FOR (i, 0, commands.count-1) {
+        layers.add(commands[i].layer);
+        serials.add(commands[i].serial);
+    }
+    List<int64_t> order = sort_by_layer_and_serial(layers.data, serials.data, commands.count, temp());
+    PROFILE_END();
+
+    if (draw_cull_commands) {
+        PROFILE_BEGIN("cull");
+        cull_to_scissors(&order);
+        PROFILE_END();
+    }
+    if (draw_clip_on_cpu) {
+        PROFILE_BEGIN("clip");
+        clip_to_scissors(&order);
+        PROFILE_END();
+    }
+    if (order.count == 0) {
+        last_serial = 0;
+        commands.reset();
+        command_words.reset();
+        return;
+    }
+
+    if (draw_eliminate_overdraw) {
+        PROFILE_BEGIN("overdraw");
+        eliminate_overdraw(&order);
+        PROFILE_END();
+    }
+
+    PROFILE_BEGIN("batching");
+    List<Batch> batches = make_list<Batch>(temp());
+    Batch first_batch = {0, 1, &commands[order[0]], nullptr};
+    if (command_kind(first_batch.cmd) == Draw_Command_Kind::TEXT) {
+        first_batch.font = text_payload(first_batch.cmd)->font;
+    }
+    batches.add(first_batch);
+    // instanced_textured_pipeline only stands in for textured_pipeline, so anything else sends the flush down the
+    // vertex path
+    bool custom_pipeline = uses_custom_pipeline(first_batch.cmd);
+    // breaks are counted when a new batch has to start, so a frame's breaks add up to its batch count minus one
+    last_flush_stats.batches = command_kind(first_batch.cmd) != Draw_Command_Kind::SCISSOR ? 1 : 0;
+    FOR (i, 1, order.count-1) {
+        Batch *current_batch = &batches[batches.count-1];
+        Draw_Command *cmd = &commands[order[i]];
+        Draw_Command *batch_cmd = current_batch->cmd;
+        custom_pipeline |= uses_custom_pipeline(cmd);
+        Font *font = command_kind(cmd) == Draw_Command_Kind::TEXT ? text_payload(cmd)->font : nullptr;
+        int64_t break_reason = -1;
+        if (command_kind(cmd) == Draw_Command_Kind::SCISSOR || command_kind(batch_cmd) == Draw_Command_Kind::SCISSOR) break_reason = BATCH_BREAK_SCISSOR;
+        else if (cmd->pipeline.id != batch_cmd->pipeline.id) break_reason = BATCH_BREAK_PIPELINE;
+        else if (font != nullptr && current_batch->font != nullptr && font != current_batch->font) break_reason = BATCH_BREAK_FONT;
+
+        if (break_reason == -1) {
+            current_batch->count += 1;
+            if (current_batch->font == nullptr) {
+                current_batch->font = font;
+            }
+        }
+        else {
+            if (command_kind(cmd) != Draw_Command_Kind::SCISSOR) {
+                if (last_flush_stats.batches > 0) {
+                    last_flush_stats.batch_breaks[break_reason] += 1;
+                }
+                last_flush_stats.batches += 1;
             }
-            default: {
-                assert(false);
+            Batch batch = {i, 1, cmd, font};
+            batches.add(batch);
+        }
+    }
+    PROFILE_END();
+
+    PROFILE_BEGIN("vertex generation");
+    bool instanced = draw_use_instancing && !custom_pipeline;
+    last_flush_stats.instancing_fallback = draw_use_instancing && custom_pipeline;
+    Vertex_Generation gen = {};
+    gen.commands = commands.data;
+    gen.order = order.data;
+    gen.command_count = order.count;
+    gen.screen_height = (float)sapp_height();
+    gen.jobs = make_list<Generation_Job>(temp());
+    List<Font *> fonts = make_list<Font *>(temp(), order.count);
+    FOR (b, 0, batches.count-1) {
+        FOR (i, 0, batches[b].count-1) {
+            fonts.add(batches[b].font);
+        }
+    }
+    gen.fonts = fonts.data;
+    List<int64_t> quad_offsets = make_list<int64_t>(temp(), order.count+1);
+    quad_offsets.add_count(order.count+1);
+    gen.quad_offsets = quad_offsets.data;
+    Retained_Flush *retained = nullptr;
+    if (draw_retain_vertices && flushes_this_frame < DRAW_MAX_RETAINED_FLUSHES) {
+        retained = &retained_flushes[flushes_this_frame];
+        List<uint64_t> command_hashes = make_list<uint64_t>(temp(), order.count);
+        command_hashes.add_count(order.count);
+        gen.command_hashes = command_hashes.data;
+    }
+    flushes_this_frame += 1;
+    run_generation_jobs((order.count + DRAW_COUNT_JOB_COMMANDS - 1) / DRAW_COUNT_JOB_COMMANDS, count_quads_job, &gen);
+    quad_offsets[0] = 0;
+    FOR (i, 1, order.count) {
+        quad_offsets[i] += quad_offsets[i-1];
+    }
+    if (retained != nullptr) {
+        generate_retained_quads(&gen, retained, instanced);
+    }
+
+    List<Batch_Draw> pending = make_list<Batch_Draw>(temp());
+    int64_t chunk_first = 0; // sorted position the chunk being queued starts at
+    FOR (b, 0, batches.count-1) {
+        Batch *batch = &batches[b];
+        Batch_Draw draw = {batch->cmd, batch->font, quad_offsets[batch->first] - quad_offsets[chunk_first], 0};
+        if (command_kind(batch->cmd) == Draw_Command_Kind::SCISSOR) {
+            pending.add(draw);
+            continue;
+        }
+        FOR (i, batch->first, batch->first + batch->count - 1) {
+            if (quad_offsets[i+1] - quad_offsets[chunk_first] >= DRAW_FLUSH_CHUNK_QUADS) {
+                draw.quad_count = quad_offsets[i+1] - quad_offsets[chunk_first] - draw.first_quad;
+                pending.add(draw);
+                if (retained == nullptr) {
+                    generate_quads(&gen, chunk_first, i+1, instanced);
+                }
+                PROFILE_END();
+                submit_pending_draws(&pending, instanced, upload_chunk(&gen, retained, chunk_first, i+1, instanced));
+                PROFILE_BEGIN("vertex generation");
+                chunk_first = i+1;
+                draw.first_quad = 0;
             }
         }
+        draw.quad_count = quad_offsets[batch->first + batch->count] - quad_offsets[chunk_first] - draw.first_quad;
+        if (draw.quad_count > 0) {
+            pending.add(draw);
+        }
+    }
+    if (retained == nullptr) {
+        generate_quads(&gen, chunk_first, order.count, instanced);
+    }
+    PROFILE_END();
+    submit_pending_draws(&pending, instanced, upload_chunk(&gen, retained, chunk_first, order.count, instanced));
+    if (retained != nullptr) {
+        // what the same flush next frame compares against
+        Stream_Ring *ring = instanced ? &instance_ring : &vertex_ring;
+        retained->current.ring_appended_frames = ring->appended_frames;
+        Retained_Output swap = retained->previous;
+        retained->previous = retained->current;
+        retained->current = swap;
     }
+    // leave the scissor the commands ended on, normally the full screen, for whatever draws after this flush
+    apply_pending_scissor();
 
     last_serial = 0;
     commands.reset();
-    vertices.reset();
+    command_words.reset();
+}
+
+Draw_Stats draw_get_last_flush_stats() {
+    return last_flush_stats;
 }
\ No newline at end of file
@@ -5,10 +5,21 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// 16 bytes. uvs are unorm16 and colors are rgba8 with red in the lowest byte, see pack_uv() and pack_color()
 struct Vertex {
-    HMM_Vec4 position;
-    HMM_Vec4 uv;
-    HMM_Vec4 color;
+    HMM_Vec2 position;
+    uint16_t uv[2];
+    uint32_t color;
+};
+
+// one quad or glyph in instanced mode, expanded to its 6 corners in the vertex shader. glyphs store min as the
+// corner that gets uv_min, so min.Y can be above max.Y.
+struct Draw_Instance {
+    HMM_Vec2 min;
+    HMM_Vec2 max;
+    uint16_t uv_min[2];
+    uint16_t uv_max[2];
+    uint32_t color;
 };
 
 enum class Draw_Command_Kind {
@@ -25,6 +36,20 @@ struct Font {
     int64_t descender;
     int64_t line_height;
     stbtt_bakedchar chars[96];
+    uint16_t packed_uvs[96][4]; // s0 t0 s1 t1 from chars, as unorm16
+    uint16_t white_uv[2];       // the middle of a white block below the glyphs, for quads batched with this font's text
+
+    // bounds on any glyph's quad relative to the pen, for culling text without laying it out. y is up from the baseline.
+    float glyph_top;
+    float glyph_bottom;
+    float glyph_max_advance; // also covers how far a glyph reaches either side of the pen
+};
+
+// the payloads of each kind of command. colors are packed, with the color multiplier already applied.
+struct Draw_Command_Quad {
+    HMM_Vec2 min;
+    HMM_Vec2 max;
+    uint32_t color;
 };
 
 struct Draw_Command_Scissor {
@@ -35,21 +60,18 @@ struct Draw_Command_Text {
     Font *font;
     String string;
     HMM_Vec2 position;
+    uint32_t color;
+    bool clip; // draw_clip_on_cpu was set, each glyph is clipped to a Rect that follows the payload
 };
 
+// a fixed-size header, which is all draw_flush() sorts and batches by. the payload for its kind is written to a
+// separate buffer that's reset every flush. the header stays put until the next draw call, so the serial can still be
+// changed after the fact.
 struct Draw_Command {
-    Draw_Command_Kind kind;
-
-    HMM_Vec2 min;
-    HMM_Vec2 max;
-    HMM_Vec4 color;
-    int64_t serial;
     int64_t layer;
-    sg_image image;
+    int64_t serial;
     sg_pipeline pipeline;
-
-    Draw_Command_Scissor scissor;
-    Draw_Command_Text    text;
+    uint32_t payload; // offset into the payload buffer in 8-byte words, shifted up past the Draw_Command_Kind in the low 2 bits
 };
 
 Font *load_font_from_file(const char *filepath, int64_t size);
@@ -57,8 +79,43 @@ Font *load_font_from_file(const char *filepath, int64_t size);
 ////////////////////////////////////////////////////////////////////////////////
 
 extern int64_t current_draw_layer;
+// quads and text both draw with this, so they can share batches
 extern sg_pipeline textured_pipeline;
-extern sg_pipeline text_pipeline;
+
+// upload one Draw_Instance per quad/glyph instead of 4 vertices. textured_pipeline is swapped for its instanced version
+// at submission. a flush with any command on another pipeline is drawn with vertices instead, see
+// Draw_Stats::instancing_fallback.
+extern bool draw_use_instancing;
+
+// split draw_flush()'s vertex generation across the worker threads from init_worker_threads(). the output is the same
+// either way, this is here to compare against the single-threaded path. how well it scales with cores hasn't been
+// measured yet, vertex_bench takes a thread count for that.
+extern bool draw_parallel_vertex_generation;
+
+// false sticks to the scalar path in draw_expand_quads(), for comparing against the SSE2/AVX2 ones
+extern bool draw_use_simd;
+
+// draw_quad() and draw_text() drop commands that are entirely off the framebuffer, and text is trimmed to the glyphs
+// on it. culled commands still take a serial, and get a scratch command to write to. draw_flush() then does the same
+// against the scissor each command sorts under, which isn't known until then.
+extern bool draw_cull_commands;
+
+// draw_flush() clips quads to their scissor and has text clip each glyph, uvs included, when its vertices are
+// generated, then drops the SCISSOR commands so scissored content batches with everything around it. the scissor is
+// the one each command sorts under, same as the GPU would use. only right for axis-aligned quads that look the same
+// however they're cut, which is everything textured_pipeline draws.
+extern bool draw_clip_on_cpu;
+
+// draw_flush() drops opaque quads that later opaque quads entirely cover and trims ones with a whole side covered, to
+// save fill rate on stacked panels. opaque means textured_pipeline and an alpha that packs to 255.
+extern bool draw_eliminate_overdraw;
+
+// each draw_flush() of a frame keeps its vertices until the same flush next frame, and only regenerates the runs of
+// sorted commands that changed. when none did, the buffers from last frame are drawn again and nothing is uploaded.
+// off by default: the whole flush is generated before anything is uploaded, so it gives up the bounded cpu-side
+// vertex memory and the overlap of generation with upload that chunked flushing has, and every command is hashed
+// whether or not anything gets reused. worth it for mostly static frames.
+extern bool draw_retain_vertices;
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -91,3 +148,57 @@ float calculate_text_width(String text, Font *font);
 
 void draw_flush();
 
+// the vertex mode's last step: each quad to 4 vertices in the corner order of the quad index buffer, min, (max.X min.Y),
+// max, (min.X max.Y), with the uvs following the same corners. draw_flush() resolves quads and glyphs to instances
+// first so the expansion can be done with wide stores.
+void draw_expand_quads(Draw_Instance *quads, int64_t count, Vertex *out);
+
+// why draw_flush() couldn't merge a command into the batch before it. quads and text share textured_pipeline and quads
+// fit in with any font's text, so switching between them doesn't break a batch.
+enum Batch_Break_Reason {
+    BATCH_BREAK_PIPELINE, // a command with its own pipeline
+    BATCH_BREAK_SCISSOR,  // a scissor change always ends the batch
+    BATCH_BREAK_FONT,     // text in a different font, which means a different atlas
+    BATCH_BREAK_REASON_COUNT,
+};
+
+extern const char *batch_break_reason_names[BATCH_BREAK_REASON_COUNT];
+
+// what the last draw_flush() produced
+struct Draw_Stats {
+    int64_t commands;
+    int64_t command_bytes; // headers and payloads
+    int64_t vertices;
+    int64_t instances; // instead of vertices when draw_use_instancing is set
+    bool instancing_fallback; // draw_use_instancing was set but a custom pipeline kept this flush on vertices
+    int64_t bytes_uploaded;
+    int64_t batches;    // runs of commands that merged, not counting scissor changes
+    int64_t draw_calls;
+    int64_t batch_breaks[BATCH_BREAK_REASON_COUNT];
+
+    // sokol calls made by submission, after skipping the ones that wouldn't have changed anything
+    int64_t pipeline_applies;
+    int64_t uniform_applies;
+    int64_t binding_applies;
+    int64_t scissor_applies;
+    int64_t buffer_appends;
+
+    // dropped by draw_quad()/draw_text() since the flush before and by this flush, see draw_cull_commands. glyphs
+    // counts both trimmed glyphs and the glyphs of culled text.
+    int64_t culled_commands;
+    int64_t culled_glyphs;
+
+    // see draw_eliminate_overdraw. pixels are what the dropped and trimmed parts would have covered.
+    int64_t occluded_quads;
+    int64_t trimmed_quads;
+    int64_t occluded_pixels;
+
+    // see draw_retain_vertices. regions are runs of sorted commands, reused ones are copied from last frame instead of
+    // generated. skipped_uploads counts the chunks drawn straight from last frame's buffers.
+    int64_t reused_regions;
+    int64_t regenerated_regions;
+    int64_t skipped_uploads;
+};
+
+Draw_Stats draw_get_last_flush_stats();
+
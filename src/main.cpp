@@ -1,8 +1,10 @@
 #include "core.h"
 #include "draw.h"
 #include "ui.h"
+#include "profiler.h"
 
 #define UI_DRAG_DROP_ITEM_LAYER (10000)
+#define UI_PROFILER_OVERLAY_LAYER (20000)
 
 Font *roboto_font_small;
 Font *roboto_font_medium;
@@ -12,6 +14,9 @@ float time_since_startup;
 
 Text_Settings default_text_settings;
 
+bool show_profiler_overlay;
+bool show_render_stats_overlay;
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -54,12 +59,12 @@ void example_text(Rect rect) {
 
 void example_buttons(Rect rect) {
     Rect button_rect = rect.center_rect().grow(50, 100, 50, 100);
-    if (ui_button(button_rect, "button1", {})->clicked) {
+    if (ui_button(button_rect, UI_ID("button1"), {})->clicked) {
         printf("Clicked 1!\n");
     }
 
     Rect button_rect2 = button_rect.offset(0, -110);
-    if (ui_button(button_rect2, "button2", {})->clicked) {
+    if (ui_button(button_rect2, UI_ID("button2"), {})->clicked) {
         printf("Clicked 2!\n");
     }
 }
@@ -76,7 +81,7 @@ void example_more_buttons(Rect rect) {
     for (int64_t i = 0; i < 5; i++) {
         UI_PUSH_ID(i);
         Rect button_rect = cut.cut_top(100).inset(5);
-        if (ui_button(button_rect, "", {})->clicked) {
+        if (ui_button(button_rect, UI_ID(""), {})->clicked) {
             printf("Clicked %lld!\n", i);
         }
     }
@@ -161,7 +166,7 @@ void draw_selectable_element(Rect entry_rect, int64_t index) {
     button_settings.color_multiplier = random_color(&rng);
 
     // if clicked, this is the new focused element
-    if (ui_button(entry_rect, "", button_settings)->clicked) {
+    if (ui_button(entry_rect, UI_ID(""), button_settings)->clicked) {
         if (!something_is_focused) {
             something_is_focused = true;
             selected_element = index;
@@ -172,24 +177,26 @@ void draw_selectable_element(Rect entry_rect, int64_t index) {
 
 void draw_grid_with_selectable_elements(Rect scroll_view_rect, Rect content_rect) {
     // draw all unfocused elements
+    const int64_t element_count = 18;
     Grid_Layout grid = make_grid_layout(content_rect, 4, 2.5f, Grid_Layout_Kind::ELEMENT_COUNT);
     int64_t focused_element = -1;
-    for (int64_t element = 0; element < 18; element++) {
-        Rect entry_rect = grid.next();
-        expand_current_scroll_view(entry_rect);
-        if (selected_element == element) {
+    if (selected_element >= 0 && selected_element < element_count) {
+        focused_element = selected_element;
+    }
+    Virtual_Range visible = ui_virtual_grid(&grid, element_count);
+    FOR (element, visible.first, visible.last) {
+        if (element == focused_element) {
             // skip the focused element. we'll draw it after
-            focused_element = element;
             continue;
         }
-        draw_selectable_element(entry_rect.inset(5), element);
+        draw_selectable_element(grid.get_rect_for_index(element).inset(5), element);
     }
 
     // lerp animation value
     if (something_is_focused && focused_element != -1) {
         selected_element_t += dt * 4;
         if (selected_element_t > 1) selected_element_t = 1;
-        ui_blocker(scroll_view_rect, "grid blocker");
+        ui_blocker(scroll_view_rect, UI_ID("grid blocker"));
     }
     else {
         selected_element_t -= dt * 4;
@@ -210,12 +217,12 @@ void draw_grid_with_selectable_elements(Rect scroll_view_rect, Rect content_rect
 
         if (something_is_focused) {
             // block the element button, doesn't make sense to click when it's focused
-            ui_blocker(entry_rect, "entry blocker");
+            ui_blocker(entry_rect, UI_ID("entry blocker"));
 
             // draw the close button
             Button_Settings close_button_settings = {};
             close_button_settings.color_multiplier = {1, .5, .5, 1};
-            if (ui_button(entry_rect.top_right_rect().grow(0, 0, 35, 35).offset(-4, -4), "close", close_button_settings)->clicked) {
+            if (ui_button(entry_rect.top_right_rect().grow(0, 0, 35, 35).offset(-4, -4), UI_ID("close"), close_button_settings)->clicked) {
                 something_is_focused = false;
             }
         }
@@ -226,7 +233,7 @@ void example_grid_with_selectable_elements(Rect rect) {
     Rect main_rect = rect.center_rect().grow(300, 450, 300, 450);
     draw_quad(main_rect, {0.25, 0.25, 0.25, 1});
     Rect content_rect = {};
-    push_scroll_view(main_rect, "grid", SCROLL_VIEW_VERTICAL, &content_rect);
+    push_scroll_view(main_rect, UI_ID("grid"), SCROLL_VIEW_VERTICAL, &content_rect);
     defer (pop_scroll_view());
     draw_grid_with_selectable_elements(main_rect, content_rect);
 }
@@ -264,7 +271,7 @@ bool do_example_button(Rect *cut, int64_t index, String button_text, Text_Settin
     if (selected_example == index) {
         bs.color_multiplier = {.5, 1, .5, 1};
     }
-    if (ui_button(rect, "", bs, button_text, ts)->clicked) {
+    if (ui_button(rect, UI_ID(""), bs, button_text, ts)->clicked) {
         selected_example = index;
     }
     return selected_example == index;
@@ -274,7 +281,7 @@ void app_update() {
     Button_Settings default_button_settings = {};
     HMM_Vec4 bg_rect_color = {0.25, 0.25, 0.25, 1};
 
-    // if (ui_button(full_screen_rect().top_right_rect().grow(0, 0, 100, 100), "open middle thing", default_button_settings)->clicked) {
+    // if (ui_button(full_screen_rect().top_right_rect().grow(0, 0, 100, 100), UI_ID("open middle thing"), default_button_settings)->clicked) {
     //     middle_thing_open = !middle_thing_open;
     // }
 
@@ -289,17 +296,17 @@ void app_update() {
         Rect sidebar_rect = full_screen.cut_left(400);
         draw_quad(sidebar_rect, {.05f, .05f, .05f, 1.0});
         Rect cut = sidebar_rect.top_rect();
-        if (do_example_button(&cut, 0,  "Rects",            example_button_ts)) { UI_PUSH_ID("example"); example_rects(full_screen);                         }
-        if (do_example_button(&cut, 1,  "Text",             example_button_ts)) { UI_PUSH_ID("example"); example_text(full_screen);                          }
-        if (do_example_button(&cut, 2,  "Serial Numbers",   example_button_ts)) { UI_PUSH_ID("example"); example_serial_numbers(full_screen);                }
-        if (do_example_button(&cut, 3,  "Buttons",          example_button_ts)) { UI_PUSH_ID("example"); example_buttons(full_screen);                       }
-        if (do_example_button(&cut, 4,  "More Buttons",     example_button_ts)) { UI_PUSH_ID("example"); example_more_buttons(full_screen);                  }
-        if (do_example_button(&cut, 5,  "Layers",           example_button_ts)) { UI_PUSH_ID("example"); example_layers(full_screen);                        }
-        if (do_example_button(&cut, 6,  "Scroll Views",     example_button_ts)) { UI_PUSH_ID("example"); example_scroll_views(full_screen);                  }
-        if (do_example_button(&cut, 7,  "Grid Layout",      example_button_ts)) { UI_PUSH_ID("example"); example_grids(full_screen);                         }
-        if (do_example_button(&cut, 8,  "Drag and Drop",    example_button_ts)) { UI_PUSH_ID("example"); example_drag_and_drop(full_screen);                 }
-        if (do_example_button(&cut, 9,  "Grid + Modal",     example_button_ts)) { UI_PUSH_ID("example"); example_grid_with_selectable_elements(full_screen); }
-        if (do_example_button(&cut, 10, "Auto-Scaling",     example_button_ts)) { UI_PUSH_ID("example"); example_autoscaling(full_screen);                   }
+        if (do_example_button(&cut, 0,  "Rects",            example_button_ts)) { UI_PUSH_ID(UI_ID("example")); example_rects(full_screen);                         }
+        if (do_example_button(&cut, 1,  "Text",             example_button_ts)) { UI_PUSH_ID(UI_ID("example")); example_text(full_screen);                          }
+        if (do_example_button(&cut, 2,  "Serial Numbers",   example_button_ts)) { UI_PUSH_ID(UI_ID("example")); example_serial_numbers(full_screen);                }
+        if (do_example_button(&cut, 3,  "Buttons",          example_button_ts)) { UI_PUSH_ID(UI_ID("example")); example_buttons(full_screen);                       }
+        if (do_example_button(&cut, 4,  "More Buttons",     example_button_ts)) { UI_PUSH_ID(UI_ID("example")); example_more_buttons(full_screen);                  }
+        if (do_example_button(&cut, 5,  "Layers",           example_button_ts)) { UI_PUSH_ID(UI_ID("example")); example_layers(full_screen);                        }
+        if (do_example_button(&cut, 6,  "Scroll Views",     example_button_ts)) { UI_PUSH_ID(UI_ID("example")); example_scroll_views(full_screen);                  }
+        if (do_example_button(&cut, 7,  "Grid Layout",      example_button_ts)) { UI_PUSH_ID(UI_ID("example")); example_grids(full_screen);                         }
+        if (do_example_button(&cut, 8,  "Drag and Drop",    example_button_ts)) { UI_PUSH_ID(UI_ID("example")); example_drag_and_drop(full_screen);                 }
+        if (do_example_button(&cut, 9,  "Grid + Modal",     example_button_ts)) { UI_PUSH_ID(UI_ID("example")); example_grid_with_selectable_elements(full_screen); }
+        if (do_example_button(&cut, 10, "Auto-Scaling",     example_button_ts)) { UI_PUSH_ID(UI_ID("example")); example_autoscaling(full_screen);                   }
     }
 
     // center scroll list
@@ -307,7 +314,7 @@ void app_update() {
     else                   middle_thing_open_t = move_toward(middle_thing_open_t, 0, 4 * dt);
 
     if (middle_thing_open || middle_thing_open_t > 0) {
-        UI_PUSH_ID("center scroll list");
+        UI_PUSH_ID(UI_ID("center scroll list"));
         float open_t_eased = ease_ping_pong(middle_thing_open_t, middle_thing_open, ease_out_quart, ease_in_quart);
         DRAW_PUSH_COLOR_MULTIPLIER(v4(open_t_eased, open_t_eased, open_t_eased, open_t_eased));
 
@@ -317,7 +324,6 @@ void app_update() {
 
         Grid_Layout grid = make_grid_layout(full_rect, 3, 1, Grid_Layout_Kind::ELEMENT_COUNT);
         Rect cut = full_rect;
-        uint64_t rng = make_random(1235125);
         FOR (column_index, 0, 3-1) {
             UI_PUSH_ID(column_index);
 
@@ -330,43 +336,45 @@ void app_update() {
             }
 
             if (column_index == 1) {
-                UI_PUSH_ID("bottom grid scroll");
+                UI_PUSH_ID(UI_ID("bottom grid scroll"));
                 Rect content_rect = {};
                 Rect scroll_view_rect = column_rect.cut_bottom(400);
-                push_scroll_view(scroll_view_rect, "grid", SCROLL_VIEW_VERTICAL, &content_rect);
+                push_scroll_view(scroll_view_rect, UI_ID("grid"), SCROLL_VIEW_VERTICAL, &content_rect);
                 defer (pop_scroll_view());
 
                 draw_grid_with_selectable_elements(scroll_view_rect, content_rect);
             }
 
             Rect content_rect = {};
-            push_scroll_view(column_rect, "scroll view", SCROLL_VIEW_VERTICAL, &content_rect);
+            push_scroll_view(column_rect, UI_ID("scroll view"), SCROLL_VIEW_VERTICAL, &content_rect);
             defer (pop_scroll_view());
 
             if (column_index == 1) {
-                UI_PUSH_ID("top horizontal scroll");
+                UI_PUSH_ID(UI_ID("top horizontal scroll"));
                 Rect horizontal_content_rect = {};
-                push_scroll_view(content_rect.cut_top(150), "horizontal 1", SCROLL_VIEW_HORIZONTAL, &horizontal_content_rect);
+                push_scroll_view(content_rect.cut_top(150), UI_ID("horizontal 1"), SCROLL_VIEW_HORIZONTAL, &horizontal_content_rect);
                 defer (pop_scroll_view());
-                FOR (element, 0, 20) {
+                Virtual_Range visible = ui_virtual_list(horizontal_content_rect, 21, 75, SCROLL_VIEW_HORIZONTAL);
+                FOR (element, visible.first, visible.last) {
                     UI_PUSH_ID(element);
-                    Rect entry_rect = horizontal_content_rect.cut_left(75);
-                    expand_current_scroll_view(entry_rect);
+                    Rect entry_rect = virtual_list_item_rect(horizontal_content_rect, element, 75, SCROLL_VIEW_HORIZONTAL);
+                    // seeded per entry so the colors don't shift as entries scroll in and out
+                    uint64_t rng = make_random(1235125 + 100000 + element);
                     Button_Settings button_settings = default_button_settings;
                     button_settings.color_multiplier = random_color(&rng);
-                    if (ui_button(entry_rect.inset(5), "", button_settings)->clicked) {
+                    if (ui_button(entry_rect.inset(5), UI_ID(""), button_settings)->clicked) {
                     }
                 }
             }
 
-            Rect cursor_rect = content_rect.top_rect();
-            FOR (j, 0, 20-1) {
+            Virtual_Range visible = ui_virtual_list(content_rect, 20, 75, SCROLL_VIEW_VERTICAL);
+            FOR (j, visible.first, visible.last) {
                 UI_PUSH_ID(j);
-                Rect entry_rect = cursor_rect.cut_top(75);
-                expand_current_scroll_view(entry_rect);
+                Rect entry_rect = virtual_list_item_rect(content_rect, j, 75, SCROLL_VIEW_VERTICAL);
+                uint64_t rng = make_random(1235125 + column_index * 1000 + j);
                 Button_Settings button_settings = default_button_settings;
                 button_settings.color_multiplier = random_color(&rng);
-                if (ui_button(entry_rect.inset(5), "", button_settings)->clicked) {
+                if (ui_button(entry_rect.inset(5), UI_ID(""), button_settings)->clicked) {
                 }
             }
         }
@@ -374,7 +382,7 @@ void app_update() {
 
     // ability bar
     if (0) {
-        UI_PUSH_ID("ability bar");
+        UI_PUSH_ID(UI_ID("ability bar"));
 
         static Array<8, HMM_Vec4> ability_bar_items;
         static bool ability_bar_initted = false;
@@ -398,7 +406,7 @@ void app_update() {
             Widget *ddsource = nullptr;
             if (HMM_LenV4(ability_bar_items[i]) > 0) {
                 Rect mouse_rect = {};
-                ddsource = drag_drop_source(entry_rect, "src", 1, (void *)i, &mouse_rect);
+                ddsource = drag_drop_source(entry_rect, UI_ID("src"), 1, (void *)i, &mouse_rect);
                 if (ddsource->active) {
                     draw_push_layer(UI_DRAG_DROP_ITEM_LAYER);
                     defer (draw_pop_layer());
@@ -409,7 +417,7 @@ void app_update() {
             }
 
             void *dropped_payload = nullptr;
-            Widget *ddtarget = drag_drop_target(entry_rect, "dst", 1, &dropped_payload);
+            Widget *ddtarget = drag_drop_target(entry_rect, UI_ID("dst"), 1, &dropped_payload);
             if (ddtarget->dropped) {
                 int64_t payload = (int64_t)dropped_payload;
                 HMM_Vec4 tmp = ability_bar_items[i];
@@ -434,7 +442,7 @@ void app_update() {
 
     // top left UI box
     if (0) {
-        UI_PUSH_ID("top left ui");
+        UI_PUSH_ID(UI_ID("top left ui"));
 
         uint64_t rng = make_random(276372);
 
@@ -450,7 +458,7 @@ void app_update() {
             button_settings.color_multiplier = random_color(&rng);
             float height = random_range_float(&rng, 50, 150);
             Rect entry_rect = cut.cut_top(height).inset(5);
-            if (ui_button(entry_rect, "", button_settings)->clicked) {
+            if (ui_button(entry_rect, UI_ID(""), button_settings)->clicked) {
                 printf("Clicked %lld\n", i);
             }
         }
@@ -461,7 +469,7 @@ void app_update() {
         // open/close tab
         {
             Rect open_close_button_rect = bg_rect.top_right_rect().grow(0, 100, 100, 0);
-            if (ui_button(open_close_button_rect, "open/close", default_button_settings)->clicked) {
+            if (ui_button(open_close_button_rect, UI_ID("open/close"), default_button_settings)->clicked) {
                 sidebar_open = !sidebar_open;
             }
 
@@ -482,6 +490,7 @@ void app_update() {
 uint64_t last_frame_start_time;
 
 void frame() {
+    profiler_begin_frame();
     temp_arena->reset();
 
     // note(josh): we aren't bothering with a fixed timestep update loop for this example. in a real application you ideally wouldn't have a variable dt like we have here
@@ -491,13 +500,49 @@ void frame() {
     ui_new_frame((float)dt);
     draw_update();
 
+    PROFILE_BEGIN("app_update");
     app_update();
+    PROFILE_END();
+
+    // F1 toggles the profiler overlay, F2 writes the last few seconds out for chrome://tracing, F3 toggles render stats,
+    // F4 switches between vertex and instanced rendering, F5 between gpu scissoring and clipping on the cpu, F6 toggles
+    // retained vertices
+    if (get_input_down(SAPP_KEYCODE_F1, true)) {
+        show_profiler_overlay = !show_profiler_overlay;
+    }
+    if (get_input_down(SAPP_KEYCODE_F3, true)) {
+        show_render_stats_overlay = !show_render_stats_overlay;
+    }
+    if (get_input_down(SAPP_KEYCODE_F4, true)) {
+        draw_use_instancing = !draw_use_instancing;
+    }
+    if (get_input_down(SAPP_KEYCODE_F5, true)) {
+        draw_clip_on_cpu = !draw_clip_on_cpu;
+    }
+    if (get_input_down(SAPP_KEYCODE_F6, true)) {
+        draw_retain_vertices = !draw_retain_vertices;
+    }
+    if (get_input_down(SAPP_KEYCODE_F2, true)) {
+        if (profiler_write_chrome_trace("profile.json")) {
+            printf("Wrote profile.json\n");
+        }
+    }
+    if (show_profiler_overlay) {
+        DRAW_PUSH_LAYER(UI_PROFILER_OVERLAY_LAYER);
+        profiler_draw_overlay(full_screen_rect().top_rect(400).inset(10), roboto_font_small);
+    }
+    if (show_render_stats_overlay) {
+        DRAW_PUSH_LAYER(UI_PROFILER_OVERLAY_LAYER);
+        profiler_draw_render_stats_overlay(full_screen_rect().right_rect(300).bottom_rect(500).inset(10), roboto_font_small);
+    }
 
     ui_end_frame();
     mouse_buttons_down = {};
     mouse_buttons_up   = {};
     mouse_screen_delta = {};
     mouse_scroll = {};
+    inputs_down = {};
+    inputs_up   = {};
 
     // render
     {
@@ -505,15 +550,12 @@ void frame() {
         pass_action.colors[0].load_action = SG_LOADACTION_CLEAR;
         pass_action.colors[0].clear_value = {0.1f, 0.1f, 0.1f, 1.0f};
         sg_begin_default_pass(&pass_action, sapp_width(), sapp_height());
-        sg_apply_pipeline(textured_pipeline);
-        HMM_Mat4 screen_proj = HMM_Orthographic_LH_ZO(0, sapp_widthf(), 0, sapp_heightf(), -1000, 1000);
-        sg_apply_uniforms(SG_SHADERSTAGE_VS, 0, SG_RANGE(screen_proj));
-
         draw_flush();
 
         sg_end_pass();
         sg_commit();
     }
+    profiler_end_frame();
 }
 
 void event(const sapp_event *evt) {
@@ -521,9 +563,15 @@ void event(const sapp_event *evt) {
 
     switch (evt->type) {
         case SAPP_EVENTTYPE_KEY_DOWN: {
+            if (!evt->key_repeat) {
+                inputs_held[evt->key_code] = true;
+                inputs_down[evt->key_code] = true;
+            }
             break;
         }
         case SAPP_EVENTTYPE_KEY_UP: {
+            inputs_held[evt->key_code] = false;
+            inputs_up[evt->key_code] = true;
             break;
         }
         case SAPP_EVENTTYPE_CHAR: {
@@ -620,10 +668,14 @@ void init() {
 
     ui_init();
     draw_init();
+    init_worker_threads(-1);
 
     last_frame_start_time = stm_now();
 
+    // startup shows up as the first frame in the profiler, so font loading can be seen in traces
+    profiler_begin_frame();
     app_init();
+    profiler_end_frame();
 }
 
 int main(int argc, char* argv[]) {
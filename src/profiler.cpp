@@ -0,0 +1,316 @@
+#include "profiler.h"
+#include "draw.h"
+#include "ui.h"
+
+// ring buffer of frames. the one at profiler_frame_index is being recorded while profiler_in_frame is set.
+static Profiler_Frame profiler_frames[PROFILER_MAX_FRAMES];
+static int64_t profiler_frame_index;
+static int64_t profiler_completed_frames;
+static bool    profiler_in_frame;
+
+static int64_t profiler_open_zones[PROFILER_MAX_DEPTH]; // -1 for zones that were dropped
+static int64_t profiler_depth;
+
+void profiler_begin_frame() {
+    assert(!profiler_in_frame && "profiler_begin_frame() called twice");
+    Profiler_Frame *frame = &profiler_frames[profiler_frame_index];
+    frame->start = stm_now();
+    frame->end = 0;
+    frame->zone_count = 0;
+    frame->dropped_zones = 0;
+    profiler_depth = 0;
+    profiler_in_frame = true;
+}
+
+void profiler_end_frame() {
+    assert(profiler_in_frame && "profiler_end_frame() without profiler_begin_frame()");
+    assert(profiler_depth == 0 && "somebody forgot to end a profiler zone");
+    profiler_frames[profiler_frame_index].end = stm_now();
+    profiler_frame_index = (profiler_frame_index + 1) % PROFILER_MAX_FRAMES;
+    profiler_completed_frames += 1;
+    profiler_in_frame = false;
+}
+
+void profiler_begin_zone(const char *name) {
+    if (!profiler_in_frame) {
+        return;
+    }
+    assert(profiler_depth < PROFILER_MAX_DEPTH);
+    Profiler_Frame *frame = &profiler_frames[profiler_frame_index];
+    if (frame->zone_count == PROFILER_MAX_ZONES_PER_FRAME) {
+        frame->dropped_zones += 1;
+        profiler_open_zones[profiler_depth] = -1;
+        profiler_depth += 1;
+        return;
+    }
+    Profiler_Zone *zone = &frame->zones[frame->zone_count];
+    zone->name = name;
+    zone->depth = profiler_depth;
+    zone->end = 0;
+    profiler_open_zones[profiler_depth] = frame->zone_count;
+    profiler_depth += 1;
+    frame->zone_count += 1;
+    // read the clock last so the bookkeeping above isn't counted against the zone
+    zone->start = stm_now();
+}
+
+void profiler_end_zone() {
+    if (!profiler_in_frame) {
+        return;
+    }
+    uint64_t now = stm_now();
+    assert(profiler_depth > 0);
+    profiler_depth -= 1;
+    int64_t index = profiler_open_zones[profiler_depth];
+    if (index >= 0) {
+        profiler_frames[profiler_frame_index].zones[index].end = now;
+    }
+}
+
+Profiler_Frame *profiler_get_frame(int64_t frames_ago) {
+    if (frames_ago < 0 || frames_ago >= IMIN(profiler_completed_frames, PROFILER_MAX_FRAMES)) {
+        return nullptr;
+    }
+    int64_t index = (profiler_frame_index - 1 - frames_ago + PROFILER_MAX_FRAMES * 2) % PROFILER_MAX_FRAMES;
+    return &profiler_frames[index];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// the same zone name can be a different pointer in each translation unit, so compare the text
+static bool profiler_same_name(const char *a, const char *b) {
+    return a == b || strcmp(a, b) == 0;
+}
+
+static HMM_Vec4 profiler_zone_color(const char *name) {
+    uint64_t rng = make_random(hash_bytes(name, (int64_t)strlen(name)));
+    HMM_Vec4 color = random_color(&rng);
+    color.W = 0.9f;
+    return color;
+}
+
+// the font isn't monospaced, so each column gets its own draw_text
+static void profiler_draw_table_row(Rect row_rect, float indent, String columns[4], Font *font) {
+    const float column_x[4] = {0, 0.55f, 0.7f, 0.85f};
+    HMM_Vec4 text_color = v4(0.9f, 0.9f, 0.9f, 1);
+    float baseline = row_rect.min.Y - (float)font->descender;
+    draw_text(columns[0], v2(row_rect.min.X + indent, baseline), font, text_color);
+    FOR (c, 1, 3) {
+        draw_text(columns[c], v2(row_rect.min.X + row_rect.width() * column_x[c], baseline), font, text_color);
+    }
+}
+
+struct Profiler_Overlay_Row {
+    const char *name;
+    int64_t depth;
+    double last_ms;
+    double total_ms;
+    double max_ms;
+};
+
+// one bar per frame with the top-level zones stacked inside it, 16.6ms and 33.3ms lines, and a table of the
+// zones two levels deep with their last/average/max times over the history.
+void profiler_draw_overlay(Rect rect, Font *font) {
+    draw_quad(rect, v4(0, 0, 0, 0.75f));
+    int64_t frame_count = IMIN(profiler_completed_frames, PROFILER_MAX_FRAMES);
+    if (frame_count == 0) {
+        return;
+    }
+
+    Rect graph_rect = rect.inset(10);
+    Rect table_rect = graph_rect.cut_right_unscaled(graph_rect.width() * 0.45f);
+    const double graph_ms = 1000.0 / 30.0;
+    float ms_to_pixels = (float)(graph_rect.height() / graph_ms);
+    float bar_width = graph_rect.width() / PROFILER_MAX_FRAMES;
+
+    FOR (frames_ago, 0, frame_count-1) {
+        Profiler_Frame *frame = profiler_get_frame(frames_ago);
+        float x = graph_rect.max.X - (frames_ago + 1) * bar_width;
+        float frame_height = (float)stm_ms(stm_diff(frame->end, frame->start)) * ms_to_pixels;
+        draw_quad(v2(x, graph_rect.min.Y), v2(x + bar_width, graph_rect.min.Y + FMIN(frame_height, graph_rect.height())), v4(0.3f, 0.3f, 0.3f, 1));
+        FOR (i, 0, frame->zone_count-1) {
+            Profiler_Zone *zone = &frame->zones[i];
+            if (zone->depth != 0 || zone->end == 0) {
+                continue;
+            }
+            float y0 = (float)stm_ms(stm_diff(zone->start, frame->start)) * ms_to_pixels;
+            float y1 = (float)stm_ms(stm_diff(zone->end,   frame->start)) * ms_to_pixels;
+            y0 = FMIN(y0, graph_rect.height());
+            y1 = FMIN(y1, graph_rect.height());
+            draw_quad(v2(x, graph_rect.min.Y + y0), v2(x + bar_width, graph_rect.min.Y + y1), profiler_zone_color(zone->name));
+        }
+    }
+    float line_60 = graph_rect.min.Y + (float)(1000.0 / 60.0) * ms_to_pixels;
+    draw_quad(v2(graph_rect.min.X, line_60), v2(graph_rect.max.X, line_60 + 1), v4(0.5f, 1, 0.5f, 0.8f));
+    draw_quad(v2(graph_rect.min.X, graph_rect.max.Y - 1), graph_rect.max, v4(1, 0.5f, 0.5f, 0.8f));
+
+    if (font == nullptr) {
+        return;
+    }
+
+    // gather rows from the latest frame, then total them up over the whole history
+    List<Profiler_Overlay_Row> rows = make_list<Profiler_Overlay_Row>(temp());
+    Profiler_Overlay_Row frame_row = {"frame", 0, 0, 0, 0};
+    rows.add(frame_row);
+    Profiler_Frame *latest = profiler_get_frame(0);
+    FOR (i, 0, latest->zone_count-1) {
+        Profiler_Zone *zone = &latest->zones[i];
+        if (zone->depth > 1) {
+            continue;
+        }
+        bool seen = false;
+        FOR (r, 1, rows.count-1) {
+            if (rows[r].depth == zone->depth + 1 && profiler_same_name(rows[r].name, zone->name)) {
+                seen = true;
+                break;
+            }
+        }
+        if (!seen) {
+            Profiler_Overlay_Row row = {zone->name, zone->depth + 1, 0, 0, 0};
+            rows.add(row);
+        }
+    }
+    FOR (frames_ago, 0, frame_count-1) {
+        Profiler_Frame *frame = profiler_get_frame(frames_ago);
+        double frame_ms = stm_ms(stm_diff(frame->end, frame->start));
+        List<double> frame_totals = make_list<double>(temp(), rows.count);
+        frame_totals.add_count(rows.count);
+        frame_totals[0] = frame_ms;
+        FOR (i, 0, frame->zone_count-1) {
+            Profiler_Zone *zone = &frame->zones[i];
+            if (zone->depth > 1 || zone->end == 0) {
+                continue;
+            }
+            FOR (r, 1, rows.count-1) {
+                if (rows[r].depth == zone->depth + 1 && profiler_same_name(rows[r].name, zone->name)) {
+                    frame_totals[r] += stm_ms(stm_diff(zone->end, zone->start));
+                    break;
+                }
+            }
+        }
+        FOR (r, 0, rows.count-1) {
+            if (frames_ago == 0) rows[r].last_ms = frame_totals[r];
+            rows[r].total_ms += frame_totals[r];
+            rows[r].max_ms = frame_totals[r] > rows[r].max_ms ? frame_totals[r] : rows[r].max_ms;
+        }
+    }
+
+    Rect cursor = table_rect.inset(0, 0, 0, 10);
+    float line_height = (float)font->line_height;
+    String header[4] = {"zone (ms)", "last", "avg", "max"};
+    profiler_draw_table_row(cursor.cut_top_unscaled(line_height), 0, header, font);
+    FOR (r, 0, rows.count-1) {
+        Profiler_Overlay_Row *row = &rows[r];
+        Rect row_rect = cursor.cut_top_unscaled(line_height);
+        if (row->depth == 1) {
+            draw_quad(row_rect.left_rect_unscaled(line_height * 0.5f).inset_unscaled(line_height * 0.15f), profiler_zone_color(row->name));
+        }
+        String columns[4] = {
+            String(row->name),
+            tprint("%.3f", row->last_ms),
+            tprint("%.3f", row->total_ms / (double)frame_count),
+            tprint("%.3f", row->max_ms),
+        };
+        profiler_draw_table_row(row_rect, line_height * (0.75f + 0.75f * row->depth), columns, font);
+    }
+    if (latest->dropped_zones > 0) {
+        Rect row_rect = cursor.cut_top_unscaled(line_height);
+        draw_text(tprint("%lld zones dropped last frame", (long long)latest->dropped_zones), v2(row_rect.min.X, row_rect.min.Y - (float)font->descender), font, v4(1, 0.5f, 0.5f, 1));
+    }
+}
+
+static void profiler_draw_stat_row(Rect *cursor, const char *name, String value, Font *font) {
+    String columns[4] = {String(name), value, {}, {}};
+    profiler_draw_table_row(cursor->cut_top_unscaled((float)font->line_height), 0, columns, font);
+}
+
+void profiler_draw_render_stats_overlay(Rect rect, Font *font) {
+    draw_quad(rect, v4(0, 0, 0, 0.75f));
+    Draw_Stats draw_stats = draw_get_last_flush_stats();
+    UI_Stats ui_stats = ui_get_last_frame_stats();
+    float line_height = (float)font->line_height;
+    Rect cursor = rect.inset(10);
+
+    profiler_draw_stat_row(&cursor, "commands",    tprint("%lld, %lld KB", (long long)draw_stats.commands, (long long)(draw_stats.command_bytes / 1024)), font);
+    profiler_draw_stat_row(&cursor, "vertices",    tprint("%lld", (long long)draw_stats.vertices), font);
+    profiler_draw_stat_row(&cursor, "instances",   tprint("%lld", (long long)draw_stats.instances), font);
+    profiler_draw_stat_row(&cursor, "uploaded",    tprint("%.1f KB", (double)draw_stats.bytes_uploaded / 1024.0), font);
+    profiler_draw_stat_row(&cursor, "batches",     tprint("%lld", (long long)draw_stats.batches), font);
+    profiler_draw_stat_row(&cursor, "draw calls",  tprint("%lld", (long long)draw_stats.draw_calls), font);
+    profiler_draw_stat_row(&cursor, "pip/uni/bind/sci", tprint("%lld/%lld/%lld/%lld",
+        (long long)draw_stats.pipeline_applies, (long long)draw_stats.uniform_applies, (long long)draw_stats.binding_applies, (long long)draw_stats.scissor_applies), font);
+    profiler_draw_stat_row(&cursor, "culled cmd/glyph", tprint("%lld/%lld", (long long)draw_stats.culled_commands, (long long)draw_stats.culled_glyphs), font);
+    profiler_draw_stat_row(&cursor, "occluded/trimmed", tprint("%lld/%lld, %.1f Mpx", (long long)draw_stats.occluded_quads, (long long)draw_stats.trimmed_quads,
+        (double)draw_stats.occluded_pixels / 1000000.0), font);
+    profiler_draw_stat_row(&cursor, "reused/regen/skip", tprint("%lld/%lld/%lld", (long long)draw_stats.reused_regions,
+        (long long)draw_stats.regenerated_regions, (long long)draw_stats.skipped_uploads), font);
+
+    // bars are relative to the most common reason so the one to go after stands out
+    cursor.cut_top_unscaled(line_height * 0.5f);
+    profiler_draw_stat_row(&cursor, "batch breaks", {}, font);
+    int64_t most_breaks = 1;
+    FOR (reason, 0, BATCH_BREAK_REASON_COUNT-1) {
+        most_breaks = IMAX(most_breaks, draw_stats.batch_breaks[reason]);
+    }
+    FOR (reason, 0, BATCH_BREAK_REASON_COUNT-1) {
+        Rect row_rect = cursor.cut_top_unscaled(line_height);
+        Rect bar_rect = row_rect.inset_unscaled(line_height * 0.2f, 0, line_height * 0.2f, row_rect.width() * 0.55f);
+        bar_rect.max.X = bar_rect.min.X + bar_rect.width() * (float)draw_stats.batch_breaks[reason] / (float)most_breaks;
+        draw_quad(bar_rect, profiler_zone_color(batch_break_reason_names[reason]));
+        String columns[4] = {String(batch_break_reason_names[reason]), tprint("%lld", (long long)draw_stats.batch_breaks[reason]), {}, {}};
+        profiler_draw_table_row(row_rect, line_height * 0.75f, columns, font);
+    }
+
+    cursor.cut_top_unscaled(line_height * 0.5f);
+    profiler_draw_stat_row(&cursor, "live widgets",    tprint("%lld", (long long)ui_stats.live_widgets), font);
+    profiler_draw_stat_row(&cursor, "updated widgets", tprint("%lld", (long long)ui_stats.updated_widgets), font);
+    profiler_draw_stat_row(&cursor, "awake widgets",   tprint("%lld", (long long)ui_stats.awake_widgets), font);
+    profiler_draw_stat_row(&cursor, "created/removed", tprint("%lld/%lld", (long long)ui_stats.created_widgets, (long long)ui_stats.removed_widgets), font);
+    profiler_draw_stat_row(&cursor, "scroll views",    tprint("%lld", (long long)ui_stats.scroll_views), font);
+    profiler_draw_stat_row(&cursor, "hit grid",        String(ui_stats.hit_grid_rebuilt ? "rebuilt" : "reused"), font);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void profiler_write_json_string(FILE *file, const char *s) {
+    fputc('"', file);
+    for (const char *c = s; *c != 0; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', file);
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+static void profiler_write_trace_event(FILE *file, bool *first, const char *name, uint64_t start, uint64_t end, uint64_t base) {
+    fprintf(file, *first ? "\n" : ",\n");
+    *first = false;
+    fprintf(file, "{\"name\":");
+    profiler_write_json_string(file, name);
+    fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}", stm_us(stm_diff(start, base)), stm_us(stm_diff(end, start)));
+}
+
+// writes every frame in the history as complete ("X") events on one thread
+bool profiler_write_chrome_trace(const char *filepath) {
+    FILE *file = fopen(filepath, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    int64_t frame_count = IMIN(profiler_completed_frames, PROFILER_MAX_FRAMES);
+    uint64_t base = frame_count > 0 ? profiler_get_frame(frame_count-1)->start : 0;
+    bool first = true;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    FORR (frames_ago, 0, frame_count-1) {
+        Profiler_Frame *frame = profiler_get_frame(frames_ago);
+        profiler_write_trace_event(file, &first, "frame", frame->start, frame->end, base);
+        FOR (i, 0, frame->zone_count-1) {
+            Profiler_Zone *zone = &frame->zones[i];
+            if (zone->end != 0) {
+                profiler_write_trace_event(file, &first, zone->name, zone->start, zone->end, base);
+            }
+        }
+    }
+    fprintf(file, "\n]}\n");
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
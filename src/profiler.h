@@ -0,0 +1,68 @@
+#pragma once
+
+#include "core.h"
+
+struct Font;
+
+////////////////////////////////////////////////////////////////////////////////
+
+// zone-based frame profiler. zones are timed with sokol_time and kept for the last PROFILER_MAX_FRAMES frames,
+// which can be drawn as an overlay or written out as a chrome trace (load it in chrome://tracing or perfetto).
+// build with PROFILER_ENABLED 0 and the zone macros compile to nothing.
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#define PROFILER_MAX_FRAMES          240
+#define PROFILER_MAX_ZONES_PER_FRAME 256
+#define PROFILER_MAX_DEPTH           32
+
+struct Profiler_Zone {
+    const char *name; // expected to be a literal, only the pointer is kept
+    uint64_t start;
+    uint64_t end;
+    int64_t depth;
+};
+
+struct Profiler_Frame {
+    uint64_t start;
+    uint64_t end;
+    int64_t zone_count;
+    int64_t dropped_zones; // zones past PROFILER_MAX_ZONES_PER_FRAME aren't recorded
+    Profiler_Zone zones[PROFILER_MAX_ZONES_PER_FRAME];
+};
+
+void profiler_begin_frame();
+void profiler_end_frame();
+
+// zones opened outside of a frame are ignored
+void profiler_begin_zone(const char *name);
+void profiler_end_zone();
+
+// the most recent complete frame is index 0, returns nullptr past the end of the history
+Profiler_Frame *profiler_get_frame(int64_t frames_ago);
+
+void profiler_draw_overlay(Rect rect, Font *font);
+
+// draw_get_last_flush_stats() and ui_get_last_frame_stats() with a bar per batch break reason, for finding
+// layouts that fragment batching
+void profiler_draw_render_stats_overlay(Rect rect, Font *font);
+bool profiler_write_chrome_trace(const char *filepath);
+
+struct Profiler_Scope {
+    Profiler_Scope(const char *name) { profiler_begin_zone(name); }
+    ~Profiler_Scope() { profiler_end_zone(); }
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_BEGIN(name) profiler_begin_zone(name)
+#define PROFILE_END()       profiler_end_zone()
+#define PROFILE_SCOPE(name) Profiler_Scope GB_DEFER_3(_profile_scope_)(name)
+#define PROFILE_FUNCTION()  PROFILE_SCOPE(__FUNCTION__)
+#else
+#define PROFILE_BEGIN(name)
+#define PROFILE_END()
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#endif
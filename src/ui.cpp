@@ -1,10 +1,36 @@
 #include "ui.h"
 #include "draw.h"
+#include "profiler.h"
 
-static List<Widget> all_widgets;
+// widgets live in a pool so their addresses never change, and nothing moves them between frames
+static Pool<Widget> widget_pool;
+static List<Widget_Handle> live_widgets;  // every widget in widget_pool, in no particular order
+static List<int64_t> sorted_widget_slots; // widget_pool slots in ascending (render_layer, serial) order
+static List<int64_t> widget_index;        // open-addressed id -> widget_pool slot, -1 for empty slots
 static List<int64_t> pushed_ids;
-static List<Widget *> pushed_scroll_views;
-static Widget *current_scroll_view;
+
+#define WIDGET_ANIM_LANES 4 // active_t, hot_t, clicked_t, dropped_t
+
+// per-slot copies of what the whole-set passes (the stale sweep, hit testing and the animation tick) read,
+// kept in flat arrays indexed by widget_pool slot so those passes don't pull entire Widgets through the cache.
+// update_widget writes both these and the Widget, which remains what callers see.
+struct Widget_Hot_Data {
+    List<uint64_t>     ids;
+    List<Widget_Flags> flags;
+    List<Rect>         hit_rects;
+    List<bool>         used_markers;
+    List<float>        anim_t;         // WIDGET_ANIM_LANES timers per slot
+    List<float>        anim_prev_t;    // anim_t before this frame's tick, so a lane whose state flipped can be redone
+    List<float>        anim_direction; // +1 or -1 per lane: the state each timer was last ticked toward
+};
+
+static Widget_Hot_Data widget_hot;
+
+// slots of the widgets that ended last frame awake, whose timers still need ticking. sleeping widgets have
+// every state false and every timer at 0 and are skipped until something wakes them, see wake_widget().
+static List<int64_t> awake_widget_slots;
+static List<Widget_Handle> pushed_scroll_views;
+static Widget_Handle current_scroll_view;
 
 static uint64_t current_id;
 
@@ -25,73 +51,484 @@ Rect full_screen_rect_value;
 static uint64_t current_drag_drop_payload_id;
 static void    *current_drag_drop_payload;
 
-static uint64_t fnv8_combine(uint64_t h, uint8_t *data, int64_t len) {
-    FOR (i, 0, len-1) {
-        h = (h * 0x100000001b3) ^ (uint64_t)data[i];
+// uniform grid over the clickable widgets' hit rects. each cell lists widget_pool slots
+// in ascending (render_layer, serial) order, so walking a cell backwards is top-down.
+struct Hit_Grid {
+    Rect bounds;
+    float cell_size;
+    int64_t cells_x;
+    int64_t cells_y;
+    List<int64_t> cell_starts; // cells_x*cells_y+1 offsets into entries
+    List<int64_t> entries;
+    uint64_t widget_set_hash;
+};
+
+static Hit_Grid hit_grid;
+static uint64_t ui_widget_set_hash; // accumulated in update_widget, compared against hit_grid.widget_set_hash next frame
+static HMM_Vec2 ui_last_hit_test_mouse_position;
+
+static UI_Stats ui_frame_stats;
+static UI_Stats ui_last_frame_stats;
+
+// what every id stack starts from. not HASH_SECRET_0, which hash_combine() would cancel out to a multiply by zero
+#define UI_ROOT_ID HASH_SECRET_1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef UI_CHECK_ID_COLLISIONS
+#ifdef NDEBUG
+#define UI_CHECK_ID_COLLISIONS 0
+#else
+#define UI_CHECK_ID_COLLISIONS 1
+#endif
+#endif
+
+#if UI_CHECK_ID_COLLISIONS
+// keeps the readable path of pushed ids next to the hashed one, and remembers which path made each widget id this
+// frame. two different paths landing on the same id is a hash collision: the widgets would share state, so say so.
+
+struct Debug_Id_Entry {
+    uint64_t id;
+    String path; // null data marks an empty slot
+};
+
+static List<uint8_t> debug_id_path;
+static List<int64_t> debug_id_path_lengths;
+static List<Debug_Id_Entry> debug_ids; // open addressing, power of two
+static int64_t debug_ids_count;
+
+// the paths of this frame's ids, kept out of temp() so big frames don't eat into it. ids past what fits go unchecked
+// for the rest of the frame.
+#define UI_DEBUG_ID_ARENA_SIZE (4 * 1024 * 1024)
+static Arena *debug_id_arena;
+static bool debug_id_arena_full;
+
+static void debug_id_path_push(String component) {
+    debug_id_path_lengths.add(debug_id_path.count);
+    uint8_t *dst = debug_id_path.add_count(component.count + 1);
+    dst[0] = '/';
+    memcpy(dst + 1, component.data, component.count);
+}
+
+static void debug_id_path_pop() {
+    debug_id_path.count = debug_id_path_lengths.pop();
+}
+
+static void debug_ids_insert(Debug_Id_Entry entry) {
+    int64_t mask = debug_ids.count - 1;
+    int64_t slot = (int64_t)(entry.id & mask);
+    while (debug_ids[slot].path.data != nullptr) {
+        slot = (slot + 1) & mask;
+    }
+    debug_ids[slot] = entry;
+}
+
+static void debug_id_collisions_new_frame() {
+    debug_id_path.reset();
+    debug_id_path_lengths.reset();
+    FOR (i, 0, debug_ids.count-1) {
+        debug_ids[i] = {};
+    }
+    debug_ids_count = 0;
+    debug_id_arena->reset();
+    debug_id_arena_full = false;
+}
+
+static void debug_check_id_collision(uint64_t id, String name) {
+    // the paths live in debug_id_arena, which is reset once per frame along with this table
+    String path = {};
+    path.count = debug_id_path.count + 1 + name.count;
+    if (debug_id_arena->cursor + path.count > debug_id_arena->capacity) {
+        if (!debug_id_arena_full) {
+            printf("UI id collision check: out of room for id paths this frame, the rest go unchecked\n");
+            debug_id_arena_full = true;
+        }
+        return;
+    }
+    path.data = (uint8_t *)alloc(debug_id_arena->allocator(), path.count, 1, false);
+    memcpy(path.data, debug_id_path.data, debug_id_path.count);
+    path.data[debug_id_path.count] = '/';
+    memcpy(path.data + debug_id_path.count + 1, name.data, name.count);
+
+    if ((debug_ids_count + 1) * 2 > debug_ids.count) {
+        List<Debug_Id_Entry> old = debug_ids;
+        int64_t capacity = IMAX(old.count * 2, 256);
+        debug_ids = make_list<Debug_Id_Entry>(default_allocator(), capacity);
+        FOR (i, 0, capacity-1) {
+            debug_ids.add({});
+        }
+        FOR (i, 0, old.count-1) {
+            if (old[i].path.data != nullptr) {
+                debug_ids_insert(old[i]);
+            }
+        }
+        free(default_allocator(), old.data);
+    }
+
+    int64_t mask = debug_ids.count - 1;
+    for (int64_t slot = (int64_t)(id & mask); debug_ids[slot].path.data != nullptr; slot = (slot + 1) & mask) {
+        if (debug_ids[slot].id == id) {
+            // the same path twice is a widget updated twice, not a collision
+            if (!(debug_ids[slot].path == path)) {
+                printf("UI id collision: \"%.*s\" and \"%.*s\" both hash to %016llx\n",
+                       STRING_COUNT_DATA(debug_ids[slot].path), STRING_COUNT_DATA(path), (unsigned long long)id);
+            }
+            return;
+        }
+    }
+    debug_ids_insert({id, path});
+    debug_ids_count += 1;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void widget_index_insert(uint64_t id, int64_t widget_slot) {
+    assert(widget_index.count > 0);
+    int64_t mask = widget_index.count - 1;
+    int64_t slot = (int64_t)(id & mask);
+    while (widget_index[slot] != -1) {
+        slot = (slot + 1) & mask;
+    }
+    widget_index[slot] = widget_slot;
+}
+
+static void widget_index_rebuild(int64_t min_widget_count) {
+    // keep the load factor at or below 50% so probe chains stay short
+    int64_t capacity = IMAX(widget_index.count, 64);
+    while (capacity < min_widget_count * 2) {
+        capacity *= 2;
+    }
+    widget_index.reset();
+    widget_index.add_count(capacity);
+    memset(widget_index.data, 0xff, sizeof(int64_t) * capacity);
+    FOR (i, 0, live_widgets.count-1) {
+        int64_t widget_slot = Pool<Widget>::slot_of(live_widgets[i]);
+        widget_index_insert(widget_hot.ids[widget_slot], widget_slot);
+    }
+}
+
+static Widget *widget_index_find(uint64_t id) {
+    if (widget_index.count == 0) {
+        return nullptr;
+    }
+    int64_t mask = widget_index.count - 1;
+    int64_t slot = (int64_t)(id & mask);
+    while (widget_index[slot] != -1) {
+        if (widget_hot.ids[widget_index[slot]] == id) {
+            return widget_pool.get_slot(widget_index[slot]);
+        }
+        slot = (slot + 1) & mask;
+    }
+    return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void sort_widgets() {
+    List<int64_t> layers  = make_list<int64_t>(temp(), live_widgets.count);
+    List<int64_t> serials = make_list<int64_t>(temp(), live_widgets.count);
+    FOR (i, 0, live_widgets.count-1) {
+        Widget *widget = widget_pool.get(live_widgets[i]);
+        layers.add(widget->render_layer);
+        serials.add(widget->serial);
+    }
+    List<int64_t> order = sort_by_layer_and_serial(layers.data, serials.data, live_widgets.count, temp());
+    sorted_widget_slots.reset();
+    FOR (i, 0, order.count-1) {
+        sorted_widget_slots.add(Pool<Widget>::slot_of(live_widgets[order[i]]));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void hit_grid_cell_range(Rect rect, int64_t *x0, int64_t *y0, int64_t *x1, int64_t *y1) {
+    *x0 = IMIN(IMAX((int64_t)((rect.min.X - hit_grid.bounds.min.X) / hit_grid.cell_size), 0), hit_grid.cells_x-1);
+    *y0 = IMIN(IMAX((int64_t)((rect.min.Y - hit_grid.bounds.min.Y) / hit_grid.cell_size), 0), hit_grid.cells_y-1);
+    *x1 = IMIN(IMAX((int64_t)((rect.max.X - hit_grid.bounds.min.X) / hit_grid.cell_size), 0), hit_grid.cells_x-1);
+    *y1 = IMIN(IMAX((int64_t)((rect.max.Y - hit_grid.bounds.min.Y) / hit_grid.cell_size), 0), hit_grid.cells_y-1);
+}
+
+static void hit_grid_build() {
+    hit_grid.cells_x = 0;
+    hit_grid.cells_y = 0;
+    hit_grid.cell_starts.reset();
+    hit_grid.entries.reset();
+
+    bool any = false;
+    FOR (i, 0, sorted_widget_slots.count-1) {
+        int64_t widget_slot = sorted_widget_slots[i];
+        if (widget_hot.flags[widget_slot] & WIDGET_FLAG_NOT_CLICKABLE) {
+            continue;
+        }
+        Rect hit_rect = widget_hot.hit_rects[widget_slot];
+        hit_grid.bounds = any ? hit_grid.bounds.encapsulate(hit_rect) : hit_rect;
+        any = true;
+    }
+    if (!any) {
+        return;
+    }
+
+    // 32px cells, but never more than 256 cells along an axis
+    float extent = FMAX(hit_grid.bounds.width(), hit_grid.bounds.height());
+    hit_grid.cell_size = FMAX(32, extent / 256);
+    hit_grid.cells_x = (int64_t)(hit_grid.bounds.width()  / hit_grid.cell_size) + 1;
+    hit_grid.cells_y = (int64_t)(hit_grid.bounds.height() / hit_grid.cell_size) + 1;
+
+    // count entries per cell, prefix sum into starts, then fill in ascending widget order
+    int64_t cell_count = hit_grid.cells_x * hit_grid.cells_y;
+    hit_grid.cell_starts.add_count(cell_count + 1);
+    FOR (k, 0, sorted_widget_slots.count-1) {
+        int64_t widget_slot = sorted_widget_slots[k];
+        if (widget_hot.flags[widget_slot] & WIDGET_FLAG_NOT_CLICKABLE) {
+            continue;
+        }
+        int64_t x0, y0, x1, y1;
+        hit_grid_cell_range(widget_hot.hit_rects[widget_slot], &x0, &y0, &x1, &y1);
+        FOR (y, y0, y1) {
+            FOR (x, x0, x1) {
+                hit_grid.cell_starts[y * hit_grid.cells_x + x + 1] += 1;
+            }
+        }
+    }
+    FOR (c, 1, cell_count) {
+        hit_grid.cell_starts[c] += hit_grid.cell_starts[c-1];
+    }
+    hit_grid.entries.add_count(hit_grid.cell_starts[cell_count]);
+
+    List<int64_t> cursors = make_list<int64_t>(temp(), cell_count);
+    memcpy(cursors.add_count(cell_count), hit_grid.cell_starts.data, sizeof(int64_t) * cell_count);
+    FOR (k, 0, sorted_widget_slots.count-1) {
+        int64_t widget_slot = sorted_widget_slots[k];
+        if (widget_hot.flags[widget_slot] & WIDGET_FLAG_NOT_CLICKABLE) {
+            continue;
+        }
+        int64_t x0, y0, x1, y1;
+        hit_grid_cell_range(widget_hot.hit_rects[widget_slot], &x0, &y0, &x1, &y1);
+        FOR (y, y0, y1) {
+            FOR (x, x0, x1) {
+                int64_t cell = y * hit_grid.cells_x + x;
+                hit_grid.entries[cursors[cell]] = widget_slot;
+                cursors[cell] += 1;
+            }
+        }
+    }
+}
+
+static void wake_widget(Widget *widget) {
+    if (widget != nullptr) {
+        widget->asleep = false;
+    }
+}
+
+static void hit_grid_query(HMM_Vec2 point) {
+    ui_hot_widget = 0;
+    ui_hot_draggable_widget = 0;
+    if (hit_grid.cells_x == 0) {
+        return;
+    }
+    if (point.X < hit_grid.bounds.min.X || point.X > hit_grid.bounds.max.X ||
+        point.Y < hit_grid.bounds.min.Y || point.Y > hit_grid.bounds.max.Y) {
+        return;
+    }
+    int64_t x, y, x1, y1;
+    hit_grid_cell_range({point, point}, &x, &y, &x1, &y1);
+    int64_t cell = y * hit_grid.cells_x + x;
+
+    // walk top-down. the first hit is the hot widget unless it is a blocker, and we keep
+    // going only as far as needed to find a draggable widget that isn't under a blocker.
+    FORR (k, hit_grid.cell_starts[cell], hit_grid.cell_starts[cell+1]-1) {
+        int64_t widget_slot = hit_grid.entries[k];
+        Rect hit_rect = widget_hot.hit_rects[widget_slot];
+        if (hit_rect.min.X <= point.X &&
+            hit_rect.min.Y <= point.Y &&
+            hit_rect.max.X >= point.X &&
+            hit_rect.max.Y >= point.Y) {
+            Widget_Flags flags = widget_hot.flags[widget_slot];
+            if (flags & WIDGET_FLAG_BLOCKER) {
+                break;
+            }
+            if (ui_hot_widget == 0) {
+                ui_hot_widget = widget_hot.ids[widget_slot];
+                wake_widget(widget_pool.get_slot(widget_slot));
+            }
+            if (flags & WIDGET_FLAG_DRAGGABLE) {
+                ui_hot_draggable_widget = widget_hot.ids[widget_slot];
+                wake_widget(widget_pool.get_slot(widget_slot));
+                break;
+            }
+        }
     }
-    return h;
 }
 
-static uint64_t fnv8(uint8_t *data, int64_t len) {
-    return fnv8_combine(0xcbf29ce484222325, data, len);
+////////////////////////////////////////////////////////////////////////////////
+
+// per-lane rates. active_t and hot_t ease both ways, clicked_t and dropped_t jump to 1 and then ease out.
+static const float WIDGET_ANIM_SPEEDS[WIDGET_ANIM_LANES]    = {10, 10, 2, 2};
+static const float WIDGET_ANIM_SNAP_MASK[WIDGET_ANIM_LANES] = {0, 0, 1, 1};
+
+// t = min(1, max(snap, t + direction * speed * dt)) where snap is 1 for a snapping lane moving up, 0 otherwise.
+// the SIMD paths below do exactly these operations so every path gives identical results.
+static float tick_widget_anim_lane(float t, float direction, float step, float snap_mask) {
+    float snap = FMAX(direction * snap_mask, 0);
+    return FMIN(1, FMAX(snap, t + direction * step));
 }
 
-static int compare_widgets(const void *_a, const void *_b) {
-    const Widget *a = (const Widget *)_a;
-    const Widget *b = (const Widget *)_b;
-    if (a->render_layer == b->render_layer) {
-        return (int)(a->serial - b->serial);
+static void widget_hot_data_add_slot(int64_t widget_slot) {
+    UNUSED(widget_slot);
+    assert(widget_slot == widget_hot.ids.count);
+    widget_hot.ids.add_count(1);
+    widget_hot.flags.add_count(1);
+    widget_hot.hit_rects.add_count(1);
+    widget_hot.used_markers.add_count(1);
+    widget_hot.anim_t.add_count(WIDGET_ANIM_LANES);
+    widget_hot.anim_prev_t.add_count(WIDGET_ANIM_LANES);
+    widget_hot.anim_direction.add_count(WIDGET_ANIM_LANES);
+}
+
+static void widget_hot_data_reset_slot(int64_t widget_slot) {
+    FOR (lane, 0, WIDGET_ANIM_LANES-1) {
+        widget_hot.anim_t        [widget_slot * WIDGET_ANIM_LANES + lane] = 0;
+        widget_hot.anim_prev_t   [widget_slot * WIDGET_ANIM_LANES + lane] = 0;
+        widget_hot.anim_direction[widget_slot * WIDGET_ANIM_LANES + lane] = -1;
     }
-    return (int)(a->render_layer - b->render_layer);
 }
 
+// advances the timers of every widget that was awake last frame toward the state it was in then. update_widget
+// redoes the lanes of widgets whose state changed this frame, which is rare. a slot's four lanes are one SSE
+// vector, and AVX2 does two slots at a time.
+static void tick_widget_animations(float dt) {
+    float *t         = widget_hot.anim_t.data;
+    float *prev_t    = widget_hot.anim_prev_t.data;
+    float *direction = widget_hot.anim_direction.data;
+    int64_t *slots   = awake_widget_slots.data;
+    int64_t count    = awake_widget_slots.count;
+    float steps[WIDGET_ANIM_LANES];
+    FOR (lane, 0, WIDGET_ANIM_LANES-1) {
+        steps[lane] = dt * WIDGET_ANIM_SPEEDS[lane];
+    }
+
+    int64_t i = 0;
+#if SIMD_AVX2
+    {
+        __m256 step = _mm256_setr_ps(steps[0], steps[1], steps[2], steps[3], steps[0], steps[1], steps[2], steps[3]);
+        __m256 mask = _mm256_setr_ps(WIDGET_ANIM_SNAP_MASK[0], WIDGET_ANIM_SNAP_MASK[1], WIDGET_ANIM_SNAP_MASK[2], WIDGET_ANIM_SNAP_MASK[3],
+                                     WIDGET_ANIM_SNAP_MASK[0], WIDGET_ANIM_SNAP_MASK[1], WIDGET_ANIM_SNAP_MASK[2], WIDGET_ANIM_SNAP_MASK[3]);
+        __m256 zero = _mm256_setzero_ps();
+        __m256 one  = _mm256_set1_ps(1);
+        for (; i + 2 <= count; i += 2) {
+            int64_t a = slots[i]   * WIDGET_ANIM_LANES;
+            int64_t b = slots[i+1] * WIDGET_ANIM_LANES;
+            __m256 v = _mm256_set_m128(_mm_loadu_ps(t + b), _mm_loadu_ps(t + a));
+            __m256 d = _mm256_set_m128(_mm_loadu_ps(direction + b), _mm_loadu_ps(direction + a));
+            _mm_storeu_ps(prev_t + a, _mm256_castps256_ps128(v));
+            _mm_storeu_ps(prev_t + b, _mm256_extractf128_ps(v, 1));
+            __m256 snap = _mm256_max_ps(_mm256_mul_ps(d, mask), zero);
+            v = _mm256_add_ps(v, _mm256_mul_ps(d, step));
+            v = _mm256_min_ps(one, _mm256_max_ps(snap, v));
+            _mm_storeu_ps(t + a, _mm256_castps256_ps128(v));
+            _mm_storeu_ps(t + b, _mm256_extractf128_ps(v, 1));
+        }
+    }
+#endif
+#if SIMD_SSE2
+    {
+        __m128 step = _mm_setr_ps(steps[0], steps[1], steps[2], steps[3]);
+        __m128 mask = _mm_setr_ps(WIDGET_ANIM_SNAP_MASK[0], WIDGET_ANIM_SNAP_MASK[1], WIDGET_ANIM_SNAP_MASK[2], WIDGET_ANIM_SNAP_MASK[3]);
+        __m128 zero = _mm_setzero_ps();
+        __m128 one  = _mm_set1_ps(1);
+        for (; i < count; i++) {
+            int64_t a = slots[i] * WIDGET_ANIM_LANES;
+            __m128 v = _mm_loadu_ps(t + a);
+            __m128 d = _mm_loadu_ps(direction + a);
+            _mm_storeu_ps(prev_t + a, v);
+            __m128 snap = _mm_max_ps(_mm_mul_ps(d, mask), zero);
+            v = _mm_add_ps(v, _mm_mul_ps(d, step));
+            v = _mm_min_ps(one, _mm_max_ps(snap, v));
+            _mm_storeu_ps(t + a, v);
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        FOR (lane, 0, WIDGET_ANIM_LANES-1) {
+            int64_t a = slots[i] * WIDGET_ANIM_LANES + lane;
+            prev_t[a] = t[a];
+            t[a] = tick_widget_anim_lane(t[a], direction[a], steps[lane], WIDGET_ANIM_SNAP_MASK[lane]);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void ui_init() {
-    all_widgets.allocator = default_allocator();
+    widget_pool = make_pool<Widget>(default_allocator());
+    live_widgets.allocator = default_allocator();
+    sorted_widget_slots.allocator = default_allocator();
+    widget_index.allocator = default_allocator();
+    widget_hot.ids.allocator = default_allocator();
+    widget_hot.flags.allocator = default_allocator();
+    widget_hot.hit_rects.allocator = default_allocator();
+    widget_hot.used_markers.allocator = default_allocator();
+    widget_hot.anim_t.allocator = default_allocator();
+    widget_hot.anim_prev_t.allocator = default_allocator();
+    widget_hot.anim_direction.allocator = default_allocator();
+    awake_widget_slots.allocator = default_allocator();
+    hit_grid.cell_starts.allocator = default_allocator();
+    hit_grid.entries.allocator = default_allocator();
     pushed_ids.allocator = default_allocator();
+#if UI_CHECK_ID_COLLISIONS
+    debug_id_path.allocator = default_allocator();
+    debug_id_path_lengths.allocator = default_allocator();
+    debug_id_arena = bootstrap_arena(default_allocator(), UI_DEBUG_ID_ARENA_SIZE);
+#endif
     pushed_scroll_views.allocator = default_allocator();
 }
 
 void ui_new_frame(float dt) {
+    PROFILE_FUNCTION();
     assert(pushed_ids.count == 0 && "somebody forgot to pop a UI id");
-    current_id = fnv8(nullptr, 0);
+    current_id = UI_ROOT_ID;
+#if UI_CHECK_ID_COLLISIONS
+    debug_id_collisions_new_frame();
+#endif
 
     ui_dt_for_last_frame = dt;
     ui_last_serial = 0;
+    ui_frame_stats = {};
 
-    FOR (i, 0, all_widgets.count-1) {
-        Widget *widget = &all_widgets[i];
-        if (widget->used_marker != ui_used_widget_marker_for_this_frame) {
-            all_widgets[i] = all_widgets[all_widgets.count-1];
-            all_widgets.count -= 1;
+    bool removed_any = false;
+    FOR (i, 0, live_widgets.count-1) {
+        if (widget_hot.used_markers[Pool<Widget>::slot_of(live_widgets[i])] != ui_used_widget_marker_for_this_frame) {
+            widget_pool.remove(live_widgets[i]);
+            live_widgets.unordered_remove_by_index(i);
             i -= 1;
+            removed_any = true;
+            ui_frame_stats.removed_widgets += 1;
             continue;
         }
     }
 
-    qsort(all_widgets.data, all_widgets.count, sizeof(Widget), compare_widgets);
+    // the index has no tombstones, so rebuild it without the removed widgets
+    if (removed_any) {
+        widget_index_rebuild(live_widgets.count);
+    }
 
-    ui_hot_widget = 0;
-    ui_hot_draggable_widget = 0;
-    FOR (i, 0, all_widgets.count-1) {
-        Widget *widget = &all_widgets[i];
-        if (widget->flags & WIDGET_FLAG_NOT_CLICKABLE) {
-            continue;
-        }
-        Rect hit_rect = widget->hit_rect;
-        if (hit_rect.min.X <= mouse_screen_position.X &&
-            hit_rect.min.Y <= mouse_screen_position.Y &&
-            hit_rect.max.X >= mouse_screen_position.X &&
-            hit_rect.max.Y >= mouse_screen_position.Y) {
-            ui_hot_widget = widget->id;
-            if (widget->flags & WIDGET_FLAG_DRAGGABLE) {
-                ui_hot_draggable_widget = widget->id;
-            }
-            if (widget->flags & WIDGET_FLAG_BLOCKER) {
-                ui_hot_widget = 0;
-                ui_hot_draggable_widget = 0;
-            }
-        }
+    tick_widget_animations(dt);
+    awake_widget_slots.reset();
+
+    // the hot widget only depends on last frame's widgets and the mouse, so skip the query when neither changed
+    bool widgets_changed = ui_widget_set_hash != hit_grid.widget_set_hash;
+    if (widgets_changed) {
+        sort_widgets();
+        hit_grid_build();
+        hit_grid.widget_set_hash = ui_widget_set_hash;
+        ui_frame_stats.hit_grid_rebuilt = true;
     }
+    if (widgets_changed || ui_last_hit_test_mouse_position != mouse_screen_position) {
+        hit_grid_query(mouse_screen_position);
+        ui_last_hit_test_mouse_position = mouse_screen_position;
+    }
+    ui_widget_set_hash = 0;
 
     ui_used_widget_marker_for_this_frame = !ui_used_widget_marker_for_this_frame;
     full_screen_rect_value = {{0, 0}, {sapp_widthf(), sapp_heightf()}};
@@ -99,30 +536,51 @@ void ui_new_frame(float dt) {
 }
 
 void ui_end_frame() {
+    ui_last_frame_stats = ui_frame_stats;
+    ui_last_frame_stats.live_widgets = live_widgets.count;
+    ui_last_frame_stats.awake_widgets = awake_widget_slots.count;
     if (current_drag_drop_payload_id != 0 && !get_mouse_held(SAPP_MOUSEBUTTON_LEFT, false)) {
         current_drag_drop_payload_id = 0;
         current_drag_drop_payload = nullptr;
     }
 }
 
-void ui_push_id(String id) {
+// strings are hashed on their own and then combined, so every kind of id costs one hash_combine() on top of
+// hashing its data, and literals were already hashed at compile time. integers and pointers skip the byte hash.
+void ui_push_id(UI_Id id) {
     pushed_ids.add(current_id);
-    current_id = fnv8_combine(current_id, id.data, id.count);
+    current_id = hash_combine(current_id, id.hash);
+#if UI_CHECK_ID_COLLISIONS
+    debug_id_path_push(String(id.name, id.name_length));
+#endif
 }
 
 void ui_push_id(int64_t index) {
     pushed_ids.add(current_id);
-    current_id = fnv8_combine(current_id, (uint8_t *)&index, sizeof(index));
+    current_id = hash_combine(current_id, (uint64_t)index);
+#if UI_CHECK_ID_COLLISIONS
+    char component[32];
+    int length = snprintf(component, sizeof(component), "#%lld", (long long)index);
+    debug_id_path_push(String(component, length));
+#endif
 }
 
 void ui_push_id(void *ptr) {
     pushed_ids.add(current_id);
-    current_id = fnv8_combine(current_id, (uint8_t *)&ptr, sizeof(ptr));
+    current_id = hash_combine(current_id, (uint64_t)(uintptr_t)ptr);
+#if UI_CHECK_ID_COLLISIONS
+    char component[32];
+    int length = snprintf(component, sizeof(component), "%p", ptr);
+    debug_id_path_push(String(component, length));
+#endif
 }
 
 void ui_pop_id() {
     assert(pushed_ids.count > 0);
     current_id = pushed_ids.pop();
+#if UI_CHECK_ID_COLLISIONS
+    debug_id_path_pop();
+#endif
 }
 
 int64_t ui_get_next_serial() {
@@ -130,48 +588,86 @@ int64_t ui_get_next_serial() {
     return ui_last_serial;
 }
 
+Widget *ui_get_widget(Widget_Handle handle) {
+    return widget_pool.get(handle);
+}
+
+UI_Stats ui_get_last_frame_stats() {
+    return ui_last_frame_stats;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 static Widget *try_get_existing_widget(uint64_t id) {
-    // note(josh): in a real implementation you would probably want a hashtable here but this is fine for demo purposes
-    FOR (i, 0, all_widgets.count-1) {
-        Widget *widget = &all_widgets[i];
-        if (widget->id == id) {
-            return widget;
-        }
-    }
-    return nullptr;
+    return widget_index_find(id);
 }
 
-static uint64_t calculate_id(String id) {
-    return fnv8_combine(current_id, id.data, id.count);
+static uint64_t calculate_id(UI_Id id) {
+    uint64_t result = hash_combine(current_id, id.hash);
+#if UI_CHECK_ID_COLLISIONS
+    debug_check_id_collision(result, String(id.name, id.name_length));
+#endif
+    return result;
 }
 
 static void force_set_active_widget(uint64_t id) {
+    wake_widget(try_get_existing_widget(id));
     ui_active_widget = id;
     ui_mouse_position_on_set_active = mouse_screen_position;
 }
 
-Widget *update_widget(Rect rect, String id, Widget_Flags flags = 0) {
+Widget *update_widget(Rect rect, UI_Id id, Widget_Flags flags = 0) {
     uint64_t real_id = calculate_id(id);
     Widget *widget = try_get_existing_widget(real_id);
     if (widget == nullptr) {
-        widget = all_widgets.add_count(1);
-        *widget = {};
+        Widget_Handle handle = widget_pool.add(&widget);
+        live_widgets.add(handle);
+        int64_t new_slot = Pool<Widget>::slot_of(handle);
+        if (new_slot == widget_hot.ids.count) {
+            widget_hot_data_add_slot(new_slot);
+        }
+        widget_hot_data_reset_slot(new_slot);
+        widget_hot.ids[new_slot] = real_id;
+        widget->handle = handle;
+        widget->id = real_id;
         widget->is_new = true;
+        ui_frame_stats.created_widgets += 1;
+        if ((live_widgets.count * 2) > widget_index.count) {
+            widget_index_rebuild(live_widgets.count);
+        }
+        else {
+            widget_index_insert(real_id, new_slot);
+        }
     }
     else {
         widget->is_new = false;
     }
+    ui_frame_stats.updated_widgets += 1;
     assert(widget != nullptr);
+    int64_t slot = Pool<Widget>::slot_of(widget->handle);
     widget->flags = flags;
     widget->rect = rect;
     widget->hit_rect = draw_clip_rect_to_current_scissor(widget->rect);
     widget->id = real_id;
     widget->serial = ui_get_next_serial();
     widget->render_layer = current_draw_layer;
-    widget->used_marker = ui_used_widget_marker_for_this_frame;
+    widget_hot.flags[slot] = flags;
+    widget_hot.hit_rects[slot] = widget->hit_rect;
+    widget_hot.used_markers[slot] = ui_used_widget_marker_for_this_frame;
+
+    uint64_t hit_rect_bits[2];
+    memcpy(hit_rect_bits, &widget->hit_rect, sizeof(hit_rect_bits));
+    ui_widget_set_hash = hash_combine(ui_widget_set_hash, widget->id);
+    ui_widget_set_hash = hash_combine(ui_widget_set_hash, widget->flags);
+    ui_widget_set_hash = hash_combine(ui_widget_set_hash, (uint64_t)widget->render_layer);
+    ui_widget_set_hash = hash_combine(ui_widget_set_hash, hit_rect_bits[0]);
+    ui_widget_set_hash = hash_combine(ui_widget_set_hash, hit_rect_bits[1]);
     widget->clicked = false;
+    widget->released_on_top = false;
+    if (widget->asleep) {
+        return widget;
+    }
+
     if (!(flags & WIDGET_FLAG_NOT_CLICKABLE)) {
         if (ui_hot_widget == widget->id) {
             if (get_mouse_down(SAPP_MOUSEBUTTON_LEFT, true)) {
@@ -196,38 +692,57 @@ Widget *update_widget(Rect rect, String id, Widget_Flags flags = 0) {
     widget->active = widget->id == ui_active_widget;
     widget->hot    = widget->id == ui_hot_widget;
 
-    if (widget->active)  { widget->active_t  = clamp(0, 1, widget->active_t  + ui_dt_for_last_frame * 10); }
-    else                 { widget->active_t  = clamp(0, 1, widget->active_t  - ui_dt_for_last_frame * 10); }
-    if (widget->hot)     { widget->hot_t     = clamp(0, 1, widget->hot_t     + ui_dt_for_last_frame * 10); }
-    else                 { widget->hot_t     = clamp(0, 1, widget->hot_t     - ui_dt_for_last_frame * 10); }
-    if (widget->clicked) { widget->clicked_t = 1;                                                         }
-    else                 { widget->clicked_t = clamp(0, 1, widget->clicked_t - ui_dt_for_last_frame * 2); }
-    if (widget->dropped) { widget->dropped_t = 1;                                                         }
-    else                 { widget->dropped_t = clamp(0, 1, widget->dropped_t - ui_dt_for_last_frame * 2); }
+    // the timers were already ticked in ui_new_frame toward last frame's states. redo any lane whose state
+    // differs from that. dropped is still last frame's value here since drag_drop_target sets it afterwards.
+    bool states[WIDGET_ANIM_LANES] = {widget->active, widget->hot, widget->clicked, widget->dropped};
+    float *anim_t = &widget_hot.anim_t[slot * WIDGET_ANIM_LANES];
+    FOR (lane, 0, WIDGET_ANIM_LANES-1) {
+        float direction = states[lane] ? 1.0f : -1.0f;
+        float *lane_direction = &widget_hot.anim_direction[slot * WIDGET_ANIM_LANES + lane];
+        if (*lane_direction != direction) {
+            *lane_direction = direction;
+            float prev_t = widget_hot.anim_prev_t[slot * WIDGET_ANIM_LANES + lane];
+            anim_t[lane] = tick_widget_anim_lane(prev_t, direction, ui_dt_for_last_frame * WIDGET_ANIM_SPEEDS[lane], WIDGET_ANIM_SNAP_MASK[lane]);
+        }
+    }
+    memcpy(&widget->active_t, anim_t, sizeof(float) * WIDGET_ANIM_LANES);
 
-    widget->released_on_top = false;
     if (widget->hot && get_mouse_up(SAPP_MOUSEBUTTON_LEFT, true)) {
         widget->released_on_top = true;
     }
+
+    bool settled = !widget->active && !widget->hot && !widget->clicked && !widget->dropped;
+    FOR (lane, 0, WIDGET_ANIM_LANES-1) {
+        settled = settled && anim_t[lane] == 0;
+    }
+    if (settled) {
+        widget->asleep = true;
+        memset(&widget_hot.anim_prev_t[slot * WIDGET_ANIM_LANES], 0, sizeof(float) * WIDGET_ANIM_LANES);
+    }
+    else {
+        awake_widget_slots.add(slot);
+    }
     return widget;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Widget *ui_blocker(Rect rect, String id) {
+Widget *ui_blocker(Rect rect, UI_Id id) {
     Widget *blocker = update_widget(rect, id, WIDGET_FLAG_BLOCKER);
     return blocker;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Widget *ui_button(Rect rect, String id, Button_Settings settings, String text/* = {}*/, Text_Settings text_settings/* = {}*/) {
+Widget *ui_button(Rect rect, UI_Id id, Button_Settings settings, String text/* = {}*/, Text_Settings text_settings/* = {}*/) {
     expand_current_scroll_view(rect);
     Widget *button = update_widget(rect, id);
     HMM_Vec4 color = settings.color;
-    color = HMM_LerpV4(color, button->hot_t,     settings.hover_color);
-    color = HMM_LerpV4(color, button->active_t,  settings.press_color);
-    color = HMM_LerpV4(color, button->clicked_t, settings.click_color);
+    if (!button->asleep) {
+        color = HMM_LerpV4(color, button->hot_t,     settings.hover_color);
+        color = HMM_LerpV4(color, button->active_t,  settings.press_color);
+        color = HMM_LerpV4(color, button->clicked_t, settings.click_color);
+    }
     color *= settings.color_multiplier;
     draw_quad(rect, color);
     if (text.count > 0) {
@@ -262,7 +777,7 @@ Grid_Layout make_grid_layout(Rect rect, float w, float h, Grid_Layout_Kind kind)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Widget *drag_drop_source(Rect rect, String id, uint64_t payload_id, void *payload, Rect *out_mouse_rect) {
+Widget *drag_drop_source(Rect rect, UI_Id id, uint64_t payload_id, void *payload, Rect *out_mouse_rect) {
     expand_current_scroll_view(rect);
     Widget *widget = update_widget(rect, id, WIDGET_FLAG_DRAGGABLE);
     if (widget->active) {
@@ -275,7 +790,7 @@ Widget *drag_drop_source(Rect rect, String id, uint64_t payload_id, void *payloa
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Widget *drag_drop_target(Rect rect, String id, uint64_t payload_id, void **payload) {
+Widget *drag_drop_target(Rect rect, UI_Id id, uint64_t payload_id, void **payload) {
     expand_current_scroll_view(rect);
     Widget *widget = update_widget(rect, id, WIDGET_FLAG_DROPPABLE);
     widget->dropped = false;
@@ -288,8 +803,9 @@ Widget *drag_drop_target(Rect rect, String id, uint64_t payload_id, void **paylo
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Widget *push_scroll_view(Rect rect, String id, Scroll_View_Flags flags, Rect *out_content_rect) {
+Widget *push_scroll_view(Rect rect, UI_Id id, Scroll_View_Flags flags, Rect *out_content_rect) {
     Widget *widget = update_widget(rect, id, WIDGET_FLAG_DRAGGABLE);
+    ui_frame_stats.scroll_views += 1;
     widget->scroll_view_flags = flags;
     widget->scroll_view_current_offset = HMM_LerpV2(widget->scroll_view_current_offset, 20 * ui_dt_for_last_frame, widget->scroll_view_target_offset);
     if (HMM_LenV2(widget->scroll_view_current_offset - widget->scroll_view_target_offset) < 1) {
@@ -298,35 +814,36 @@ Widget *push_scroll_view(Rect rect, String id, Scroll_View_Flags flags, Rect *ou
     widget->scroll_view_content_rect = rect.offset(widget->scroll_view_current_offset.X, widget->scroll_view_current_offset.Y);
     *out_content_rect = widget->scroll_view_content_rect;
     pushed_scroll_views.add(current_scroll_view);
-    current_scroll_view = widget;
+    current_scroll_view = widget->handle;
     draw_push_scissor(rect);
     return widget;
 }
 
 void pop_scroll_view() {
-    assert(current_scroll_view != nullptr);
+    Widget *scroll_view = widget_pool.get(current_scroll_view);
+    assert(scroll_view != nullptr);
 
-    HMM_Vec2 new_target_offset = current_scroll_view->scroll_view_target_offset;
-    if (current_scroll_view->active) {
+    HMM_Vec2 new_target_offset = scroll_view->scroll_view_target_offset;
+    if (scroll_view->active) {
         HMM_Vec2 mouse_delta = mouse_screen_delta;
-        if (!(current_scroll_view->scroll_view_flags & SCROLL_VIEW_HORIZONTAL)) mouse_delta.X = 0;
-        if (!(current_scroll_view->scroll_view_flags & SCROLL_VIEW_VERTICAL))   mouse_delta.Y = 0;
+        if (!(scroll_view->scroll_view_flags & SCROLL_VIEW_HORIZONTAL)) mouse_delta.X = 0;
+        if (!(scroll_view->scroll_view_flags & SCROLL_VIEW_VERTICAL))   mouse_delta.Y = 0;
         new_target_offset += mouse_delta / ui_scale_factor;
     }
-    if (ui_hot_draggable_widget == current_scroll_view->id) {
+    if (ui_hot_draggable_widget == scroll_view->id) {
         HMM_Vec2 scroll = get_mouse_scroll(true);
-        if (!(current_scroll_view->scroll_view_flags & SCROLL_VIEW_HORIZONTAL)) scroll.X = 0;
-        if (!(current_scroll_view->scroll_view_flags & SCROLL_VIEW_VERTICAL))   scroll.Y = 0;
+        if (!(scroll_view->scroll_view_flags & SCROLL_VIEW_HORIZONTAL)) scroll.X = 0;
+        if (!(scroll_view->scroll_view_flags & SCROLL_VIEW_VERTICAL))   scroll.Y = 0;
         new_target_offset -= scroll * 25;
     }
 
-    Rect target_content_rect = current_scroll_view->scroll_view_content_rect.offset(-current_scroll_view->scroll_view_current_offset.X, -current_scroll_view->scroll_view_current_offset.Y);
+    Rect target_content_rect = scroll_view->scroll_view_content_rect.offset(-scroll_view->scroll_view_current_offset.X, -scroll_view->scroll_view_current_offset.Y);
     target_content_rect = target_content_rect.offset(new_target_offset.X, new_target_offset.Y);
 
-    float top_delta    = target_content_rect.max.Y - current_scroll_view->rect.max.Y;
-    float right_delta  = target_content_rect.max.X - current_scroll_view->rect.max.X;
-    float bottom_delta = target_content_rect.min.Y - current_scroll_view->rect.min.Y;
-    float left_delta   = target_content_rect.min.X - current_scroll_view->rect.min.X;
+    float top_delta    = target_content_rect.max.Y - scroll_view->rect.max.Y;
+    float right_delta  = target_content_rect.max.X - scroll_view->rect.max.X;
+    float bottom_delta = target_content_rect.min.Y - scroll_view->rect.min.Y;
+    float left_delta   = target_content_rect.min.X - scroll_view->rect.min.X;
 
     if (top_delta < 0) {
         new_target_offset.Y -= top_delta / ui_scale_factor;
@@ -342,17 +859,105 @@ void pop_scroll_view() {
         new_target_offset.X -= left_delta / ui_scale_factor;
     }
 
-    current_scroll_view->scroll_view_target_offset = new_target_offset;
+    scroll_view->scroll_view_target_offset = new_target_offset;
 
     current_scroll_view = pushed_scroll_views.pop();
     draw_pop_scissor();
 }
 
 void expand_current_scroll_view(Rect rect) {
-    if (current_scroll_view == nullptr) {
+    Widget *scroll_view = widget_pool.get(current_scroll_view);
+    if (scroll_view == nullptr) {
         return;
     }
-    current_scroll_view->scroll_view_content_rect = current_scroll_view->scroll_view_content_rect.encapsulate(rect);
+    scroll_view->scroll_view_content_rect = scroll_view->scroll_view_content_rect.encapsulate(rect);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// the part of the current scroll view that is on screen. push_scroll_view() already clipped the scissor to it.
+static Rect visible_scroll_view_rect(Rect fallback) {
+    Widget *scroll_view = widget_pool.get(current_scroll_view);
+    if (scroll_view != nullptr) {
+        fallback = scroll_view->rect;
+    }
+    return draw_clip_rect_to_current_scissor(fallback);
+}
+
+// the items overlapping [visible_min, visible_max], for items of size extent starting at start and
+// going toward +inf along the axis.
+static Virtual_Range visible_item_range(double start, double extent, double visible_min, double visible_max, int64_t item_count) {
+    Virtual_Range range = {0, -1};
+    if (item_count <= 0 || extent <= 0 || visible_max <= visible_min) {
+        return range;
+    }
+    double first = floor((visible_min - start) / extent);
+    double last  = ceil((visible_max - start) / extent) - 1;
+    if (first < 0)              first = 0;
+    if (last > item_count - 1)  last  = (double)(item_count - 1);
+    if (last < first) {
+        return range;
+    }
+    range.first = (int64_t)first;
+    range.last  = (int64_t)last;
+    return range;
+}
+
+Rect virtual_list_item_rect(Rect content_rect, int64_t index, float item_extent, Scroll_View_Flags direction) {
+    float extent = item_extent * ui_scale_factor;
+    if (direction == SCROLL_VIEW_HORIZONTAL) {
+        Rect result = content_rect.left_rect_unscaled(extent);
+        return result.offset_unscaled((float)((double)extent * index), 0);
+    }
+    Rect result = content_rect.top_rect_unscaled(extent);
+    return result.offset_unscaled(0, -(float)((double)extent * index));
+}
+
+Virtual_Range ui_virtual_list(Rect content_rect, int64_t item_count, float item_extent, Scroll_View_Flags direction) {
+    if (item_count <= 0) {
+        return {0, -1};
+    }
+    double extent = item_extent * ui_scale_factor;
+    double total = extent * item_count;
+    Rect visible = visible_scroll_view_rect(content_rect);
+    if (direction == SCROLL_VIEW_HORIZONTAL) {
+        Rect all_items = content_rect.left_rect_unscaled((float)total);
+        expand_current_scroll_view(all_items);
+        if (all_items.min.Y >= visible.max.Y || all_items.max.Y <= visible.min.Y) {
+            return {0, -1};
+        }
+        return visible_item_range(content_rect.min.X, extent, visible.min.X, visible.max.X, item_count);
+    }
+    Rect all_items = content_rect.top_rect_unscaled((float)total);
+    expand_current_scroll_view(all_items);
+    if (all_items.min.X >= visible.max.X || all_items.max.X <= visible.min.X) {
+        return {0, -1};
+    }
+    // measure downward from the top so the items still go toward +inf
+    return visible_item_range(-content_rect.max.Y, extent, -visible.max.Y, -visible.min.Y, item_count);
+}
+
+Virtual_Range ui_virtual_grid(Grid_Layout *grid, int64_t item_count) {
+    if (item_count <= 0 || grid->elements_per_row <= 0) {
+        return {0, -1};
+    }
+    int64_t row_count = (item_count + grid->elements_per_row - 1) / grid->elements_per_row;
+    Rect all_items = grid->root_entry_rect;
+    all_items.max.X = all_items.min.X + grid->element_width * grid->elements_per_row;
+    all_items.min.Y = all_items.max.Y - (float)((double)grid->element_height * row_count);
+    expand_current_scroll_view(all_items);
+
+    Rect visible = visible_scroll_view_rect(all_items);
+    if (all_items.min.X >= visible.max.X || all_items.max.X <= visible.min.X) {
+        return {0, -1};
+    }
+    Virtual_Range rows = visible_item_range(-grid->root_entry_rect.max.Y, grid->element_height, -visible.max.Y, -visible.min.Y, row_count);
+    Virtual_Range range = {0, -1};
+    if (rows.last >= rows.first) {
+        range.first = rows.first * grid->elements_per_row;
+        range.last  = IMIN(item_count-1, (rows.last+1) * grid->elements_per_row - 1);
+    }
+    return range;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -17,15 +17,64 @@ typedef uint64_t Scroll_View_Flags; enum {
     SCROLL_VIEW_VERTICAL   = 1 << 1,
 };
 
+// the name a widget or a pushed id is given, and its hash. string literals go through the template constructor, which
+// is constexpr, so optimized builds fold the hash in and using one costs a single hash_combine() no matter how long it
+// is. the compiler doesn't have to do that, and unoptimized builds hash the literal every time. UI_ID("name") hashes
+// it with HASH_LITERAL(), which is computed at compile time in every build.
+// Strings are hashed when they're converted. pass a C string as String(cstr).
+struct UI_Id {
+    const char *name;
+    int64_t name_length;
+    uint64_t hash;
+
+    template<size_t N>
+    constexpr UI_Id(const char (&literal)[N])
+    : name(literal)
+    , name_length(literal_length(literal, N))
+    , hash(hash_literal(literal, literal_length(literal, N))) {
+    }
+
+    // for UI_ID(), with the hash already computed
+    template<size_t N>
+    constexpr UI_Id(const char (&literal)[N], uint64_t literal_hash)
+    : name(literal)
+    , name_length(literal_length(literal, N))
+    , hash(literal_hash) {
+    }
+
+    UI_Id(String string)
+    : name((const char *)string.data)
+    , name_length(string.count)
+    , hash(hash_bytes(string.data, string.count)) {
+    }
+
+    // a char buffer binds to the literal constructor too, so stop at the terminator rather than trusting N
+    static constexpr int64_t literal_length(const char *literal, size_t N) {
+        int64_t length = 0;
+        while (length < (int64_t)N-1 && literal[length] != 0) {
+            length += 1;
+        }
+        return length;
+    }
+};
+
+#define UI_ID(literal) UI_Id(literal, HASH_LITERAL(literal))
+
+// stays valid across frames for as long as the widget keeps being updated, see ui_get_widget()
+typedef uint32_t Widget_Handle;
+
 struct Widget {
     uint64_t id;
+    Widget_Handle handle;
     Widget_Flags flags;
     Rect rect;
     Rect hit_rect;
     int64_t serial;
     int64_t render_layer;
-    bool used_marker;
     bool is_new;
+    // set once every state is false and every timer has settled at 0. update_widget skips input and
+    // animation work for sleeping widgets until hover, activation or a drop wakes them up.
+    bool asleep;
 
     bool active;
     bool hot;
@@ -33,6 +82,8 @@ struct Widget {
     bool released_on_top;
     bool dropped;
 
+    // copies of the animation timers, which are stored and ticked in bulk inside ui.cpp.
+    // these four must stay together and in this order.
     float active_t;
     float hot_t;
     float clicked_t;
@@ -55,7 +106,7 @@ static Rect full_screen_rect() {
     return full_screen_rect_value;
 }
 
-void ui_push_id(String id);
+void ui_push_id(UI_Id id);
 void ui_push_id(int64_t index);
 void ui_push_id(void *ptr);
 void ui_pop_id();
@@ -63,6 +114,22 @@ void ui_pop_id();
 
 int64_t ui_get_next_serial();
 
+// returns nullptr if the widget was not updated last frame and has been cleaned up since
+Widget *ui_get_widget(Widget_Handle handle);
+
+// widget counts for the last frame between ui_new_frame() and ui_end_frame()
+struct UI_Stats {
+    int64_t live_widgets;    // in the pool after the frame
+    int64_t updated_widgets; // update_widget() calls
+    int64_t awake_widgets;   // updated and still animating or interacting, the rest took the sleeping path
+    int64_t created_widgets;
+    int64_t removed_widgets; // not updated the frame before, swept at the start of this one
+    int64_t scroll_views;
+    bool    hit_grid_rebuilt;
+};
+
+UI_Stats ui_get_last_frame_stats();
+
 ////////////////////////////////////////////////////////////////////////////////
 
 enum class Text_VAlign {
@@ -89,7 +156,7 @@ Rect ui_text(Rect rect, String string, Text_Settings settings);
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Widget *ui_blocker(Rect rect, String id);
+Widget *ui_blocker(Rect rect, UI_Id id);
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -101,19 +168,19 @@ struct Button_Settings {
     HMM_Vec4 color_multiplier = {1, 1, 1, 1};
 };
 
-Widget *ui_button(Rect rect, String id, Button_Settings settings, String text = {}, Text_Settings text_settings = {});
+Widget *ui_button(Rect rect, UI_Id id, Button_Settings settings, String text = {}, Text_Settings text_settings = {});
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Widget *drag_drop_source(Rect rect, String id, uint64_t payload_id, void *payload, Rect *out_mouse_rect);
+Widget *drag_drop_source(Rect rect, UI_Id id, uint64_t payload_id, void *payload, Rect *out_mouse_rect);
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Widget *drag_drop_target(Rect rect, String id, uint64_t payload_id, void **payload);
+Widget *drag_drop_target(Rect rect, UI_Id id, uint64_t payload_id, void **payload);
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Widget *push_scroll_view(Rect rect, String id, Scroll_View_Flags flags, Rect *out_content_rect);
+Widget *push_scroll_view(Rect rect, UI_Id id, Scroll_View_Flags flags, Rect *out_content_rect);
 void pop_scroll_view();
 void expand_current_scroll_view(Rect rect);
 
@@ -158,4 +225,22 @@ Grid_Layout make_grid_layout(Rect rect, float w, float h, Grid_Layout_Kind kind)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// for scroll views with more items than you want to build every frame. these declare the size of all the items to
+// the current scroll view up front and return the ones that are visible at its current offset, so only those need
+// to be built. the range is inclusive to go with FOR, and empty (last < first) when nothing is visible.
+struct Virtual_Range {
+    int64_t first;
+    int64_t last;
+};
+
+// item_count items of item_extent each (scaled, like cut_top()) stacked down from the top of content_rect,
+// or rightward from its left edge if direction is SCROLL_VIEW_HORIZONTAL.
+Virtual_Range ui_virtual_list(Rect content_rect, int64_t item_count, float item_extent, Scroll_View_Flags direction);
+Rect virtual_list_item_rect(Rect content_rect, int64_t index, float item_extent, Scroll_View_Flags direction);
+
+// item_count items laid out by grid, row by row. use grid->get_rect_for_index() for the visible ones.
+Virtual_Range ui_virtual_grid(Grid_Layout *grid, int64_t item_count);
+
+////////////////////////////////////////////////////////////////////////////////
+
 // todo(josh): text input
\ No newline at end of file